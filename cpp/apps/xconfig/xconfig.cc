@@ -2,27 +2,56 @@
 #include "xconfig/version.h"
 #include "xconfig/XConfig.h"
 #include "xconfig/stringutils.h"
+#include "xconfig/procutils.h"
+#include "xconfig/codegen.h"
+#include "xconfig/ConfigServer.h"
+#include "xconfig/Diff.h"
+#include "xconfig/Snapshot.h"
+#include "xconfig/LayeredConfig.h"
 #include <boost/program_options.hpp>
 #include <iostream>
+#include <fstream>
 #include <strstream>
 #include <optional>
 #include <map>
+#include <limits>
+#include <csignal>
 using namespace std;
 using namespace xconfig;
 namespace po=boost::program_options;
 
+// count allocations (reported with --memory-stats)
+void*operator new(size_t n){return xconfig::countedalloc(n);}
+void operator delete(void*p)noexcept{xconfig::countedfree(p);}
+
 namespace{
 // variables set in cmdline parsing
 bool program_dump=false;
 bool memory_dump=false;
+bool deps_dump=false;
+bool memory_stats=false;
 bool export_var=false;
 bool single_quote=false;
 bool noquote=false;
+bool cpp_header=false;
+string cpp_namespace="";
 char ns_separator='_';
 string regex_filter="";
 vector<string>variable_filter;
 vector<string>namespace_filter;
+vector<string>exclude_regex_filter;
+vector<string>exclude_variable_filter;
+vector<string>exclude_namespace_filter;
 optional<string>inputfile;
+optional<string>serve_socket;
+optional<string>client_socket;
+optional<string>trace_file;
+optional<string>snapshot_file;
+optional<string>diff_file;
+size_t max_changes=numeric_limits<size_t>::max();
+map<string,Mmvm::Value>overrides;
+XConfigOptions xfgopts;
+ConfigServer*server=nullptr;
 
 // cmdline optins
 po::options_description visible_options{string("usage: [-h|-P|-D] [<inputfile>]")};
@@ -50,13 +79,37 @@ void cmdline(int argc,char*argv[]){
   visible_options.add_options()("version,v","print version number of xconfig and exit");
   visible_options.add_options()("program-dump,P","dump compiled code (for debug purpose)");
   visible_options.add_options()("memory-dump,M","dump memory (all variables) after compiling and running configuration (for debug purpose)");
+  visible_options.add_options()("memory-stats","print allocations per load phase (scan, parse, validate, run, extract) and size of vm structures");
+  visible_options.add_options()("deps-dump,G","dump dependency graph (variable <- variables, environment variables and commands it depends on)");
   visible_options.add_options()("single-quote,S","enclose value in single quotes ('abc') instead of in couble quaotes (\"abc\")");
   visible_options.add_options()("noquote,N","do not encluse value in quote");
   visible_options.add_options()("export,e","add 'export' before each variable name");
+  visible_options.add_options()("cpp-header,C","write variables as a C++ header with inline constexpr values in nested namespaces");
+  visible_options.add_options()("cpp-namespace",po::value<string>(),"namespace enclosing generated C++ code - 'a' or 'a::b' (used together with --cpp-header)");
   visible_options.add_options()("separator,s",po::value<string>(),"character to be used as namespace separator - default '_'");
   visible_options.add_options()("regex-filter,r",po::value<string>(),"regular expression used to filter variables - filter all variables");
+  visible_options.add_options()("define,D",po::value<vector<string>>(),"override (or add) variable with value after evaluating configuration: -D name=value (option can be repeated)");
   visible_options.add_options()("variables,V",po::value<string>(),"list of space separated variable names (within a single/double quoted string) to include in output");
   visible_options.add_options()("namespaces,n",po::value<string>(),"list of space separated namespaces (within a single/double quoted string) to include in output");
+  visible_options.add_options()("exclude-regex,x",po::value<vector<string>>(),"regular expression for variables to exclude from output (option can be repeated)");
+  visible_options.add_options()("exclude-variables,X",po::value<string>(),"list of space separated variable names (within a single/double quoted string) to exclude from output");
+  visible_options.add_options()("exclude-namespaces",po::value<string>(),"list of space separated namespaces (within a single/double quoted string) to exclude from output");
+  visible_options.add_options()("cmd-timeout",po::value<long>(),"max time in ms a single command may execute before it is killed");
+  visible_options.add_options()("deadline",po::value<long>(),"max time in ms for evaluating configuration - commands still executing when deadline passes are killed");
+  visible_options.add_options()("max-children",po::value<size_t>(),"max #of commands executing concurrently");
+  visible_options.add_options()("no-cache","do not use cached command output and do not update the cache");
+  visible_options.add_options()("refresh-cache","execute all cached commands and update the cache");
+  visible_options.add_options()("cache-ttl",po::value<long>(),"cache output of all commands for #of seconds (default: only commands inside 'cache <ttl> <expr>' are cached)");
+  visible_options.add_options()("cache-dir",po::value<string>(),"directory for cached command output (default: $XDG_CACHE_HOME/xconfig or $HOME/.cache/xconfig)");
+  visible_options.add_options()("serve",po::value<string>(),"evaluate configuration once and answer queries on a unix domain socket (configuration is re-evaluated when the file changes)");
+  visible_options.add_options()("client",po::value<string>(),"get variables from a server started with --serve instead of evaluating a configuration");
+  visible_options.add_options()("trace",po::value<string>(),"write a timeline of compile phases, statements and commands (with source lines) as chrome trace event JSON to file");
+  visible_options.add_options()("compile-threads",po::value<size_t>(),"compile blocks of the configuration split at top level namespaces on #of threads (0: one per core)");
+  visible_options.add_options()("pipelined","start executing statements while the rest of the configuration is being compiled");
+  visible_options.add_options()("snapshot",po::value<string>(),"write selected variables with their types to a snapshot file instead of to stdout (see --diff)");
+  visible_options.add_options()("diff",po::value<string>(),"write differences between this configuration or snapshot file (old) and the input file (new) - all variables are compared");
+  visible_options.add_options()("max-changes",po::value<size_t>(),"stop after #of differences (used together with --diff)");
+  visible_options.add_options()("coproc","execute commands in one long lived shell co-process instead of starting a new shell for each command");
 
   // concatenate all options
   po::options_description all_options;
@@ -72,9 +125,18 @@ void cmdline(int argc,char*argv[]){
   if(vm.count("version"))printversion();
   if(vm.count("program-dump"))program_dump=true;
   if(vm.count("memory-dump"))memory_dump=true;
+  if(vm.count("deps-dump"))deps_dump=true;
+  if(vm.count("memory-stats"))memory_stats=true;
   if(vm.count("single-quote"))single_quote=true;
   if(vm.count("noquote"))noquote=true;
   if(vm.count("export"))export_var=true;
+  if(vm.count("cpp-header"))cpp_header=true;
+  if(vm.count("cpp-namespace")){
+    // namespace must be a C++ identifier or identifiers separated by '::'
+    cpp_namespace=vm["cpp-namespace"].as<string>();
+    std::regex re("[a-zA-Z_][a-zA-Z0-9_]*(::[a-zA-Z_][a-zA-Z0-9_]*)*");
+    if(!regex_match(cpp_namespace,re))throw runtime_error("invalid C++ namespace: '"s+cpp_namespace+"' - namespace must match [a-zA-Z_][a-zA-Z0-9_]*(::[a-zA-Z_][a-zA-Z0-9_]*)*");
+  }
   if(vm.count("separator")){
     // make sure separator has a valid value
     // (must only contain characters in: [a-zA-Z0-9_])
@@ -87,10 +149,58 @@ void cmdline(int argc,char*argv[]){
   if(vm.count("regex-filter"))regex_filter=vm["regex-filter"].as<string>();
   if(vm.count("variables"))variable_filter=splitonblanks(vm["variables"].as<string>());
   if(vm.count("namespaces"))namespace_filter=splitonblanks(vm["namespaces"].as<string>());
+  if(vm.count("exclude-regex"))exclude_regex_filter=vm["exclude-regex"].as<vector<string>>();
+  if(vm.count("exclude-variables"))exclude_variable_filter=splitonblanks(vm["exclude-variables"].as<string>());
+  if(vm.count("exclude-namespaces"))exclude_namespace_filter=splitonblanks(vm["exclude-namespaces"].as<string>());
+  if(vm.count("define")){
+    for(auto const&def:vm["define"].as<vector<string>>()){
+      auto[name,val]=parseoverride(def);
+      overrides.insert_or_assign(name,val);
+    }
+  }
   if(vm.count("inputfile"))inputfile=vm["inputfile"].as<string>();
-
-  // if no variables have been specified and no regex has been specified and no namspaces have been specified then include all variables
-  if(vm.count("regex-filter")==0&&vm.count("variables")==0&&vm.count("namespaces")==0)regex_filter="[a-zA-Z0-9_\\.]+";
+  if(vm.count("cmd-timeout")){
+    long ms=vm["cmd-timeout"].as<long>();
+    if(ms<=0)throw runtime_error("invalid value for option --cmd-timeout: "s+to_string(ms)+" - value must be a positive #of milliseconds");
+    xfgopts.cmdtimeout=chrono::milliseconds(ms);
+  }
+  if(vm.count("deadline")){
+    long ms=vm["deadline"].as<long>();
+    if(ms<=0)throw runtime_error("invalid value for option --deadline: "s+to_string(ms)+" - value must be a positive #of milliseconds");
+    xfgopts.deadline=chrono::milliseconds(ms);
+  }
+  if(vm.count("no-cache")&&vm.count("refresh-cache"))throw runtime_error("options --no-cache and --refresh-cache cannot be combined");
+  if(vm.count("no-cache"))xfgopts.cachemode=CmdCache::Mode::off;
+  if(vm.count("refresh-cache"))xfgopts.cachemode=CmdCache::Mode::refresh;
+  if(vm.count("cache-ttl"))xfgopts.cachettl=chrono::seconds(vm["cache-ttl"].as<long>());
+  if(vm.count("cache-dir"))xfgopts.cachedir=vm["cache-dir"].as<string>();
+  if(vm.count("coproc"))xfgopts.shellmode=Mmvm::ShellMode::coproc;
+  if(vm.count("pipelined"))xfgopts.pipelined=true;
+  if(vm.count("compile-threads"))xfgopts.compilethreads=vm["compile-threads"].as<size_t>();
+  if(vm.count("trace")){
+    trace_file=vm["trace"].as<string>();
+    xfgopts.tracer=make_shared<Tracer>(inputfile?inputfile.value():"stdin");
+  }
+  if(vm.count("snapshot"))snapshot_file=vm["snapshot"].as<string>();
+  if(vm.count("diff"))diff_file=vm["diff"].as<string>();
+  if(vm.count("max-changes"))max_changes=vm["max-changes"].as<size_t>();
+  if(diff_file&&!inputfile)throw runtime_error("option --diff requires an input file");
+  if(vm.count("max-children"))setmaxchildren(vm["max-children"].as<size_t>());
+  if(vm.count("serve"))serve_socket=vm["serve"].as<string>();
+  if(vm.count("client"))client_socket=vm["client"].as<string>();
+  if(diff_file&&(serve_socket||client_socket||snapshot_file))throw runtime_error("option --diff cannot be combined with --serve, --client or --snapshot");
+  if(serve_socket&&client_socket)throw runtime_error("options --serve and --client cannot be combined");
+  if(serve_socket&&!inputfile)throw runtime_error("option --serve requires an input file");
+  if(client_socket&&inputfile)throw runtime_error("option --client cannot be combined with an input file");
+  if(!overrides.empty()&&(serve_socket||client_socket||diff_file))throw runtime_error("option --define cannot be combined with --serve, --client or --diff");
+  if(trace_file&&(serve_socket||client_socket))throw runtime_error("option --trace cannot be combined with --serve or --client");
+}
+// build query from filters
+// (if no variables, regex or namespaces have been specified all variables that are not excluded are included)
+QueryRules queryrules(){
+  QueryRules ret{variable_filter,namespace_filter,{},exclude_variable_filter,exclude_namespace_filter,exclude_regex_filter};
+  if(regex_filter!="")ret.regexes.push_back(regex_filter);
+  return ret;
 }
 // write one variable to stdout
 void writevar(ostream&os,string const&name,string const&value){
@@ -104,6 +214,48 @@ void writevar(ostream&os,string const&name,string const&value){
     os<<tmp_name<<"="<<quote<<value<<quote<<endl;
   }
 }
+// write timeline trace if requested
+// (also written when evaluation fails)
+void writetrace(){
+  if(!trace_file||!xfgopts.tracer)return;
+  ofstream os(trace_file.value());
+  if(!os)throw runtime_error("failed opening trace file: "s+trace_file.value()+" for writing");
+  xfgopts.tracer->writejson(os);
+}
+// call 'f' with a cursor over the variables of a snapshot file or of an evaluated configuration
+template<typename F>
+void withcursor(string const&path,F&&f){
+  if(issnapshot(path)){
+    ifstream is(path.c_str(),ifstream::in);
+    if(!is)throw runtime_error("failed opening file: "s+path+" for reading");
+    SnapshotReader rd(is);
+    f(rd);
+  }else{
+    XConfig xfg(path,xfgopts);
+    StoreCursor c(xfg.basicx().vm()->mem());
+    f(c);
+  }
+}
+// write differences between two configurations and/or snapshot files to stdout
+void writediffs(string const&oldpath,string const&newpath){
+  withcursor(oldpath,[&](auto&oldc){
+    withcursor(newpath,[&](auto&newc){
+      // (look for one more difference than is written to tell whether any differences were left out)
+      size_t limit=max_changes<numeric_limits<size_t>::max()?max_changes+1:max_changes;
+      size_t nwritten=0;
+      size_t nchanges=diff(oldc,newc,[&nwritten](DiffEntry::Kind kind,string const&name,Mmvm::Value const*oldval,Mmvm::Value const*newval){
+                                       if(nwritten==max_changes)return;
+                                       writediff(cout,kind,name,oldval,newval);
+                                       ++nwritten;
+                                     },limit);
+      if(nchanges>max_changes)cerr<<"stopped after "<<nwritten<<" differences"<<endl;
+    });
+  });
+}
+// stop server when a signal is received
+void stopserver(int){
+  if(server)server->stop();
+}
 }
 // 'xconfig' main program
 int main(int argc,char*argv[]){
@@ -111,46 +263,79 @@ int main(int argc,char*argv[]){
     // get cmdline params
     cmdline(argc,argv);
 
-    // compile and run configuration file
-    // (if no input file is specified we read from stdin)
-    unique_ptr<XConfig>xfg;
-    if(inputfile)xfg.reset(new XConfig(inputfile.value()));
-    else xfg.reset(new XConfig());
-
-    // process vm memory after compiling and running configuration file
-    if(program_dump){
-      cout<<"<program-dump>"<<endl;
-      xfg->dumpprog(cout);
+    // serve configuration until SIGINT or SIGTERM is received
+    if(serve_socket){
+      ConfigServer srv(inputfile.value(),serve_socket.value(),xfgopts);
+      server=&srv;
+      signal(SIGINT,stopserver);
+      signal(SIGTERM,stopserver);
+      srv.run();
+      server=nullptr;
+      return 0;
     }
-    if(memory_dump){
-      cout<<"<memory-dump>"<<endl;
-      xfg->dumpmem(cout);
+    // compare configurations
+    if(diff_file){
+      writediffs(diff_file.value(),inputfile.value());
+      return 0;
     }
-    // collect variables from regex to include
+    // get variables from server
     map<string,string>varmap;
-    auto&&varmap_regex{(*xfg)(regex(regex_filter))};
-    for(auto&&[name,value]:varmap_regex)varmap[name]=value;
+    map<string,Mmvm::Value>valmap;
+    if(client_socket){
+      valmap=queryserver(client_socket.value(),queryrules());
+      for(auto&&[name,value]:valmap)varmap[name]=Mmvm::val2string(value);
+    }else{
+      // compile and run configuration file
+      // (if no input file is specified we read from stdin)
+      shared_ptr<XConfig>xfg;
+      if(inputfile)xfg.reset(new XConfig(inputfile.value(),xfgopts));
+      else xfg.reset(new XConfig(cin,"stdin",xfgopts));
+      writetrace();
 
-    // collect variables specified by name to include
-    auto&&varmap_var{(*xfg)(variable_filter)};
-    for(auto&&[name,value]:varmap_var){
-      if(value)varmap[name]=value.value();
-    }
-    // collect variables from namespaces to include
-    auto&&varmap_ns{xfg->basicx().ns(namespace_filter)};
-    for(auto&&[name,value]:varmap_ns)varmap[name]=value;
+      // process vm memory after compiling and running configuration file
+      if(program_dump){
+        cout<<"<program-dump>"<<endl;
+        xfg->dumpprog(cout);
+      }
+      if(memory_dump){
+        cout<<"<memory-dump>"<<endl;
+        xfg->dumpmem(cout);
+      }
+      if(deps_dump){
+        cout<<"<deps-dump>"<<endl;
+        xfg->dumpdeps(cout);
+      }
+      // apply overrides on top of evaluated configuration (configuration is not re-evaluated)
+      LayeredConfig cfg(xfg);
+      if(!overrides.empty())cfg=cfg.derive(overrides);
 
-    // write variables specified by name
-    for(auto&&[name,value]:varmap)writevar(cout,name,value);
-    
-    // NOTE! Not yet done
-    // - add option for generating C++ skeleton code for parsing file
-    // - add option for selecting based on namespaces (internally would use regular expression) (BasicExtractor::ns(...)
-    // - add 'negative' option with regex for what not to include
-    // - add 'negative' option with names for what not to include
+      // collect variables selected by filters (one pass over all variables)
+      valmap=cfg.asValue(Query(queryrules()));
+      for(auto&&[name,value]:valmap)varmap[name]=Mmvm::val2string(value);
+      if(memory_stats){
+        cout<<"<memory-stats>"<<endl;
+        writememstats(cout,xfg->memoryStats());
+      }
+    }
+    // write variables as a snapshot, as C++ code or as variable assignments
+    if(snapshot_file){
+      ofstream os(snapshot_file.value());
+      if(!os)throw runtime_error("failed opening snapshot file: "s+snapshot_file.value()+" for writing");
+      writesnapshot(os,valmap);
+    }else if(cpp_header){
+      writecppheader(cout,valmap,cpp_namespace);
+    }else{
+      for(auto&&[name,value]:varmap)writevar(cout,name,value);
+    }
   }
   catch(exception const&e){
     cerr<<"error: "<<e.what()<<endl;
+    try{
+      writetrace();
+    }
+    catch(exception const&e){
+      cerr<<"error: "<<e.what()<<endl;
+    }
     return 1;
   }
 }
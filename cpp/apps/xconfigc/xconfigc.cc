@@ -0,0 +1,108 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/version.h"
+#include "xconfig/XConfig.h"
+#include "xconfig/codegen.h"
+#include <boost/program_options.hpp>
+#include <iostream>
+#include <fstream>
+#include <optional>
+#include <regex>
+using namespace std;
+using namespace xconfig;
+namespace po=boost::program_options;
+
+namespace{
+// variables set in cmdline parsing
+string symbol="xconfig_program";
+optional<string>outputfile;
+optional<string>headerfile;
+optional<string>inputfile;
+
+// cmdline optins
+po::options_description visible_options{string("usage: [-h|-v] [-o <outputfile>] [-H <headerfile>] [-s <symbol>] [<inputfile>]")};
+
+void usage(){
+  std::cerr<<visible_options;
+  std::exit(1);
+}
+void printversion(){
+  cout<<XCONFIG_VERSION_MAJOR<<"."<<XCONFIG_VERSION_MINOR<<endl;
+  std::exit(0);
+}
+// process cmd line params
+void cmdline(int argc,char*argv[]){
+  // positional parameters
+  po::positional_options_description positional_options;
+  positional_options.add("inputfile", -1);
+
+  // hidden options (will not show up in '--help')
+  po::options_description hidden_options("hidden options");
+  hidden_options.add_options()("inputfile",po::value<string>(),"");
+
+  // setup visible options (will show up in '--help')
+  visible_options.add_options()("help,h","help");
+  visible_options.add_options()("version,v","print version number of xconfigc and exit");
+  visible_options.add_options()("output,o",po::value<string>(),"C++ source file to write compiled program to - default stdout");
+  visible_options.add_options()("header,H",po::value<string>(),"C++ header file to write declaration of compiled program to");
+  visible_options.add_options()("symbol,s",po::value<string>(),"name of variable holding compiled program - default 'xconfig_program'");
+
+  // concatenate all options
+  po::options_description all_options;
+  all_options.add(visible_options).add(hidden_options);
+
+  // process options
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc,argv).options(all_options).positional(positional_options).run(),vm);
+  po::notify(vm);
+
+  // get command line parameters
+  if(vm.count("help"))usage();
+  if(vm.count("version"))printversion();
+  if(vm.count("output"))outputfile=vm["output"].as<string>();
+  if(vm.count("header"))headerfile=vm["header"].as<string>();
+  if(vm.count("inputfile"))inputfile=vm["inputfile"].as<string>();
+  if(vm.count("symbol")){
+    symbol=vm["symbol"].as<string>();
+    std::regex re("[a-zA-Z_][a-zA-Z0-9_]*");
+    if(!regex_match(symbol,re))throw runtime_error("invalid symbol name: '"s+symbol+"' - symbol must match [a-zA-Z_][a-zA-Z0-9_]*");
+  }
+}
+// write a file (or stdout if no file is specified)
+template<typename F>
+void writefile(optional<string>const&path,F&&f){
+  if(!path){
+    f(cout);
+    return;
+  }
+  ofstream os(path.value());
+  if(!os)throw runtime_error("failed opening file: "s+path.value()+" for writing");
+  f(os);
+  if(!os)throw runtime_error("failed writing file: "s+path.value());
+}
+}
+// 'xconfigc' main program - compiles a configuration file into a C++ source file containing the compiled program
+int main(int argc,char*argv[]){
+  try{
+    // get cmdline params
+    cmdline(argc,argv);
+
+    // compile (but do not run) configuration file
+    // (if no input file is specified we read from stdin)
+    shared_ptr<Mmvm>vm;
+    string name=inputfile?inputfile.value():"stdin"s;
+    if(inputfile){
+      ifstream is(inputfile.value());
+      if(!is)throw runtime_error("failed opening file: "s+inputfile.value()+" for reading");
+      vm=XConfig::compile(is,name);
+    }else{
+      vm=XConfig::compile(cin,name);
+    }
+    // write compiled program (and optionally a header declaring it)
+    writefile(outputfile,[&](ostream&os){writeembeddedprog(os,*vm,symbol,name);});
+    if(headerfile)writefile(headerfile,[&](ostream&os){writeembeddedheader(os,symbol);});
+  }
+  catch(exception const&e){
+    cerr<<"error: "<<e.what()<<endl;
+    return 1;
+  }
+}
@@ -44,14 +44,16 @@ int main(){
     for(auto&&[name,value]:sysns)cout<<name<<": "<<value<<endl;
 
     // get all variables as Value objects
-    cout<<"-------- [variables as Value objects - we know the type of the variable (i.e. int or string)]"<<endl;
+    cout<<"-------- [variables as Value objects - we know the type of the variable (i.e. int, string, list or map)]"<<endl;
     auto vmap=xfg.asValue();
     for(auto&&[name,value]:vmap){
       cout<<name<<": ";
       visit([](auto&&v){
         using V=std::decay_t<decltype(v)>;
         if constexpr(std::is_same_v<V,std::string>)cout<<v<<"[string]";
-        else cout<<v<<"[int]";
+        else if constexpr(std::is_same_v<V,int>)cout<<v<<"[int]";
+        else if constexpr(std::is_same_v<V,List>)cout<<v<<"[list]";
+        else cout<<v<<"[map]";
       },value);
       cout<<endl;
     }
@@ -0,0 +1,71 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/stringutils.h"
+#include "xconfig/Symtab.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+using namespace std;
+using namespace xconfig;
+
+/*
+ * throughput of 'interpolate(...)' and 'deescape(...)' on megabyte sized values
+ * (for example output of a command such as: @`cat bigfile`)
+ * usage: interpbench [<MB per value>] [<#of iterations>]
+ */
+namespace{
+// create a value of 'n' bytes with a special character every 'every' bytes (0: no special characters)
+string makevalue(size_t n,size_t every,string const&special){
+  string ret;
+  ret.reserve(n);
+  while(ret.size()<n){
+    if(every&&ret.size()%every==0&&ret.size()+special.size()<=n)ret+=special;
+    else ret.push_back('a'+ret.size()%26);
+  }
+  return ret;
+}
+// run 'f' on a copy of 'str' a number of times and print MB/s
+// (the copy is made outside of the timed section)
+template<typename F>
+void bench(string const&name,string const&str,int niter,F&&f){
+  chrono::nanoseconds elapsed{0};
+  size_t outbytes=0;
+  for(int i=0;i<niter;++i){
+    string tmp=str;
+    auto start=chrono::steady_clock::now();
+    auto res=f(std::move(tmp));
+    elapsed+=chrono::steady_clock::now()-start;
+    if(!res.first){
+      cerr<<name<<": "<<res.second<<endl;
+      exit(1);
+    }
+    outbytes+=res.second.size();
+  }
+  double secs=chrono::duration<double>(elapsed).count();
+  double mb=static_cast<double>(str.size())*niter/(1024*1024);
+  cout<<left<<setw(32)<<name<<right<<setw(12)<<fixed<<setprecision(1)<<mb/secs<<" MB/s"<<setw(16)<<outbytes/niter<<" bytes out"<<endl;
+}
+}
+int main(int argc,char*argv[]){
+  size_t mb=argc>1?atoi(argv[1]):16;
+  int niter=argc>2?atoi(argv[2]):10;
+  size_t n=mb*1024*1024;
+
+  // interpolation callbacks
+  Symtab symtab;
+  symtab.addsym("x");
+  auto fenv=[](string const&){return pair(true,"env"s);};
+  auto fvar=[](string const&){return pair(true,"var"s);};
+  auto fcmd=[](string const&){return pair(true,"cmd"s);};
+  auto finterp=[&](string&&str){return interpolate(std::move(str),fenv,fvar,fcmd,symtab);};
+  auto fdeescape=[](string&&str){return deescape(std::move(str),{'"'});};
+
+  cout<<"value size: "<<mb<<" MB, iterations: "<<niter<<endl;
+  bench("interpolate (plain)",makevalue(n,0,""),niter,finterp);
+  bench("interpolate (%x every 4KB)",makevalue(n,4096,"%x "),niter,finterp);
+  bench("interpolate (%x every 64B)",makevalue(n,64,"%x "),niter,finterp);
+  bench("deescape (plain)",makevalue(n,0,""),niter,fdeescape);
+  bench("deescape (\\\" every 4KB)",makevalue(n,4096,"\\\""),niter,fdeescape);
+  bench("deescape (\\\" every 64B)",makevalue(n,64,"\\\""),niter,fdeescape);
+}
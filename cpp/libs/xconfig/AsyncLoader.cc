@@ -0,0 +1,321 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/AsyncLoader.h"
+#include "xconfig/procutils.h"
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+using namespace std;
+namespace xconfig{
+
+// helpers
+namespace{
+// shell executing commands (same as in Mmvm::execcmd)
+string const shellpath="/usr/bin/bash";
+
+// max time in ms to wait for events while loads are waiting for a child process slot
+// (slots can be released by other threads without the loader being notified)
+constexpr int waitslotpollms=10;
+
+// epoll keys: (load id << 1) | kind, timer has its own key
+constexpr uint64_t pipekind=0;
+constexpr uint64_t pidkind=1;
+constexpr uint64_t timerkey=~uint64_t(0);
+
+// add fd to an epoll set
+void epolladd(int epfd,int fd,uint64_t key){
+  epoll_event ev;
+  memset(&ev,0,sizeof(ev));
+  ev.events=EPOLLIN;
+  ev.data.u64=key;
+  if(epoll_ctl(epfd,EPOLL_CTL_ADD,fd,&ev)<0)throw runtime_error("epoll_ctl failed: "s+strerror(errno));
+}
+// remove fd from an epoll set and close it
+void epolldel(int epfd,int&fd){
+  epoll_ctl(epfd,EPOLL_CTL_DEL,fd,nullptr);
+  eclose(fd);
+  fd=-1;
+}
+}
+// state of a load
+struct AsyncLoader::Load{
+  size_t id;
+  string name;
+  XConfigOptions opts;
+  shared_ptr<Mmvm>vm;
+  promise<shared_ptr<XConfig>>prom;
+
+  // command being executed (cpid < 0 if no command is running)
+  int cpid=-1;
+  int fdread=-1;                        // stdout of command
+  int pidfd=-1;                         // readable when command terminates (-1 if not supported by kernel)
+  string output;
+  bool eof=false;
+  bool exited=false;
+  int stat=0;
+  bool timedout=false;
+  bool waitslot=false;                  // waiting for a free child process slot
+  optional<chrono::steady_clock::time_point>deadline;
+};
+// ctor
+AsyncLoader::AsyncLoader():epfd_(-1),timerfd_(-1),nextid_(0){
+  epfd_=epoll_create1(EPOLL_CLOEXEC);
+  if(epfd_<0)throw runtime_error("epoll_create1 failed: "s+strerror(errno));
+  timerfd_=timerfd_create(CLOCK_MONOTONIC,TFD_CLOEXEC|TFD_NONBLOCK);
+  if(timerfd_<0){
+    int err=errno;
+    eclose(epfd_);
+    throw runtime_error("timerfd_create failed: "s+strerror(err));
+  }
+  epolladd(epfd_,timerfd_,timerkey);
+}
+// dtor
+AsyncLoader::~AsyncLoader(){
+  for(auto&[id,load]:loads_){
+    if(load->cpid<0)continue;
+    kill(-load->cpid,SIGKILL);
+    if(load->fdread>=0)eclose(load->fdread);
+    if(load->pidfd>=0)eclose(load->pidfd);
+    int stat;
+    waitpid(load->cpid,&stat,0);
+    releasechildslot();
+  }
+  eclose(timerfd_);
+  eclose(epfd_);
+}
+// start loading a configuration from a file
+future<shared_ptr<XConfig>>AsyncLoader::load(string const&cfgpath,XConfigOptions const&opts){
+  ifstream is(cfgpath.c_str(),ifstream::in);
+  if(!is){
+    promise<shared_ptr<XConfig>>prom;
+    prom.set_exception(make_exception_ptr(runtime_error("failed opening file: "s+cfgpath+" for reading")));
+    return prom.get_future();
+  }
+  return load(is,cfgpath,opts);
+}
+// start loading a configuration from a stream
+future<shared_ptr<XConfig>>AsyncLoader::load(istream&is,string const&name,XConfigOptions const&opts){
+  auto newload=make_unique<Load>();
+  newload->id=nextid_++;
+  newload->name=name;
+  newload->opts=opts;
+  auto ret=newload->prom.get_future();
+  Load&load=*newload;
+  loads_[load.id]=std::move(newload);
+
+  // compile and run until first command
+  step(load,[&](){
+    load.vm=XConfig::prepare(is,name,opts);
+    return load.vm->startasync();
+  });
+  return ret;
+}
+// get epoll fd
+int AsyncLoader::fd()const noexcept{
+  return epfd_;
+}
+// process events
+size_t AsyncLoader::poll(int timeoutms){
+  if(!waiting_.empty()&&(timeoutms<0||timeoutms>waitslotpollms))timeoutms=waitslotpollms;
+  epoll_event evs[64];
+  int nev=epoll_wait(epfd_,evs,64,timeoutms);
+  if(nev<0&&errno!=EINTR)throw runtime_error("epoll_wait failed: "s+strerror(errno));
+  for(int i=0;i<nev;++i){
+    uint64_t key=evs[i].data.u64;
+    if(key==timerkey){
+      ontimer();
+      continue;
+    }
+    // (load may have finished while processing an earlier event)
+    auto it=loads_.find(key>>1);
+    if(it==loads_.end())continue;
+    Load&load=*it->second;
+    if((key&1)==pipekind&&load.fdread>=0)readcmd(load);
+    else if((key&1)==pidkind&&load.pidfd>=0)reapcmd(load);
+  }
+  startwaiting();
+  return pending();
+}
+// process events until all loads have finished
+void AsyncLoader::wait(){
+  while(pending())poll(-1);
+}
+// #of loads not yet finished
+size_t AsyncLoader::pending()const noexcept{
+  return loads_.size();
+}
+// run or resume vm of a load until it finishes or must wait for a command
+// (a command which cannot be started is reported to the vm as a failed command)
+void AsyncLoader::step(Load&load,function<Mmvm::RunState()>const&f){
+  try{
+    Mmvm::RunState state=f();
+    while(state==Mmvm::RunState::suspended){
+      auto res=startcmd(load);
+      if(!res)return;
+      state=load.vm->resume(res.value());
+    }
+    finish(load,nullptr);
+  }
+  catch(...){
+    finish(load,current_exception());
+  }
+}
+// start command a vm waits for
+// (returns a result if command could not be started, else std::nullopt)
+optional<Mmvm::CmdResult>AsyncLoader::startcmd(Load&load){
+  // get a child process slot
+  auto deadline=load.vm->pendingdeadline();
+  auto now=chrono::steady_clock::now();
+  if(!acquirechildslot(now)){
+    if(deadline&&deadline.value()<=now){
+      return Mmvm::CmdResult{false,"deadline passed while waiting for a free child process slot",true};
+    }
+    load.waitslot=true;
+    load.deadline=deadline;
+    waiting_.push_back(load.id);
+    armtimer();
+    return nullopt;
+  }
+  load.waitslot=false;
+
+  // spawn command in a new process group so it can be killed together with its descendants
+  int fdwrite;
+  vector<string>args={"bash","-c",load.vm->pendingcmd()};
+  auto err=spawnpipchld(shellpath,args,load.vm->env().envp(),load.fdread,fdwrite,load.cpid,true,true);
+  if(err){
+    releasechildslot();
+    load.cpid=-1;
+    load.fdread=-1;
+    return Mmvm::CmdResult{false,err.value(),false};
+  }
+  eclose(fdwrite);
+  fcntl(load.fdread,F_SETFL,fcntl(load.fdread,F_GETFL)|O_NONBLOCK);
+  load.pidfd=static_cast<int>(syscall(SYS_pidfd_open,load.cpid,0));
+  load.output.clear();
+  load.eof=false;
+  load.exited=false;
+  load.timedout=false;
+  load.deadline=deadline;
+  epolladd(epfd_,load.fdread,(load.id<<1)|pipekind);
+  if(load.pidfd>=0)epolladd(epfd_,load.pidfd,(load.id<<1)|pidkind);
+  armtimer();
+  return nullopt;
+}
+// read output from command
+void AsyncLoader::readcmd(Load&load){
+  char buf[4096];
+  while(true){
+    ssize_t nread=read(load.fdread,buf,sizeof(buf));
+    if(nread<0&&errno==EINTR)continue;
+    if(nread<0&&(errno==EAGAIN||errno==EWOULDBLOCK))return;
+    if(nread<=0)break;
+    load.output.append(buf,nread);
+  }
+  // eof - without a pidfd we wait for the command here (it has closed its stdout so it normally terminates shortly)
+  epolldel(epfd_,load.fdread);
+  load.eof=true;
+  if(load.pidfd<0){
+    waitpid(load.cpid,&load.stat,0);
+    load.exited=true;
+  }
+  if(load.exited)completecmd(load);
+}
+// reap command after it terminated
+void AsyncLoader::reapcmd(Load&load){
+  if(waitpid(load.cpid,&load.stat,WNOHANG)!=load.cpid)return;
+  epolldel(epfd_,load.pidfd);
+  load.exited=true;
+  if(load.eof)completecmd(load);
+}
+// command has terminated and all output has been read - resume vm
+void AsyncLoader::completecmd(Load&load){
+  releasechildslot();
+  load.cpid=-1;
+  Mmvm::CmdResult res;
+  if(load.timedout){
+    res=Mmvm::CmdResult{false,"child process killed after deadline passed",true};
+  }else{
+    auto[ok,out]=exitstat2result(load.stat,load.output);
+    res=Mmvm::CmdResult{ok,std::move(out),false};
+  }
+  step(load,[&](){return load.vm->resume(res);});
+  armtimer();
+}
+// start commands of loads waiting for a child process slot
+void AsyncLoader::startwaiting(){
+  size_t nwaiting=waiting_.size();
+  for(size_t i=0;i<nwaiting;++i){
+    size_t id=waiting_.front();
+    waiting_.pop_front();
+    auto it=loads_.find(id);
+    if(it==loads_.end())continue;
+    step(*it->second,[](){return Mmvm::RunState::suspended;});
+  }
+}
+// deadline timer expired - kill commands and fail waiting loads whose deadline has passed
+void AsyncLoader::ontimer(){
+  uint64_t nexp;
+  [[maybe_unused]]ssize_t stat=read(timerfd_,&nexp,sizeof(nexp));
+  auto now=chrono::steady_clock::now();
+  vector<size_t>expired;
+  for(auto&[id,load]:loads_){
+    if(!load->deadline||load->deadline.value()>now)continue;
+    if(load->cpid>=0&&!load->timedout){
+      kill(-load->cpid,SIGKILL);
+      load->timedout=true;
+    }else if(load->waitslot){
+      expired.push_back(id);
+    }
+  }
+  for(size_t id:expired){
+    Load&load=*loads_[id];
+    load.waitslot=false;
+    waiting_.erase(std::remove(waiting_.begin(),waiting_.end(),id),waiting_.end());
+    step(load,[&](){
+      return load.vm->resume(Mmvm::CmdResult{false,"deadline passed while waiting for a free child process slot",true});
+    });
+  }
+  armtimer();
+}
+// arm timer to expire at earliest deadline of running or waiting commands
+void AsyncLoader::armtimer(){
+  optional<chrono::steady_clock::time_point>earliest;
+  for(auto const&[id,load]:loads_){
+    bool active=(load->cpid>=0&&!load->timedout)||load->waitslot;
+    if(!active||!load->deadline)continue;
+    if(!earliest||load->deadline.value()<earliest.value())earliest=load->deadline;
+  }
+  itimerspec its;
+  memset(&its,0,sizeof(its));
+  if(earliest){
+    // (steady_clock is CLOCK_MONOTONIC)
+    auto ns=chrono::duration_cast<chrono::nanoseconds>(earliest.value().time_since_epoch()).count();
+    if(ns<=0)ns=1;
+    its.it_value.tv_sec=ns/1000000000;
+    its.it_value.tv_nsec=ns%1000000000;
+  }
+  timerfd_settime(timerfd_,TFD_TIMER_ABSTIME,&its,nullptr);
+}
+// finish a load - set result and remove load
+void AsyncLoader::finish(Load&load,exception_ptr err){
+  if(!err){
+    try{
+      load.prom.set_value(shared_ptr<XConfig>(new XConfig(load.vm,load.name,load.opts)));
+    }
+    catch(...){
+      err=current_exception();
+    }
+  }
+  if(err)load.prom.set_exception(err);
+  loads_.erase(load.id);
+}
+}
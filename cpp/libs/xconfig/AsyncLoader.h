@@ -0,0 +1,69 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include "xconfig/XConfig.h"
+#include <string>
+#include <memory>
+#include <future>
+#include <map>
+#include <deque>
+#include <optional>
+#include <functional>
+#include <iosfwd>
+namespace xconfig{
+
+// load configurations asynchronously on the calling thread
+// (a configuration is compiled when its load is started - while it is evaluated the vm suspends on each command and
+//  the loader multiplexes output and termination of all running commands using epoll)
+// (the loader is not thread safe - all calls must be made from the same thread)
+class AsyncLoader{
+public:
+  // ctor,assign,dtor
+  // (dtor kills running commands - futures of loads that have not finished get a 'broken_promise' error)
+  AsyncLoader();
+  AsyncLoader(AsyncLoader const&)=delete;
+  AsyncLoader(AsyncLoader&&)=delete;
+  AsyncLoader&operator=(AsyncLoader const&)=delete;
+  AsyncLoader&operator=(AsyncLoader&&)=delete;
+  ~AsyncLoader();
+
+  // start loading a configuration
+  // (all errors, including compilation errors, are reported through the future)
+  std::future<std::shared_ptr<XConfig>>load(std::string const&cfgpath,XConfigOptions const&opts=XConfigOptions{});
+  std::future<std::shared_ptr<XConfig>>load(std::istream&is,std::string const&name,XConfigOptions const&opts=XConfigOptions{});
+
+  // file descriptor which becomes readable when the loader has events to process
+  // (register it in an event loop and call 'poll(0)' when it is readable)
+  int fd()const noexcept;
+
+  // process events waiting at most 'timeoutms' ms for an event (-1 --> wait until an event occurs)
+  // (returns #of loads not yet finished)
+  std::size_t poll(int timeoutms=0);
+
+  // process events until all loads have finished
+  void wait();
+
+  // #of loads not yet finished
+  std::size_t pending()const noexcept;
+private:
+  // state of a load (defined in .cc file)
+  struct Load;
+
+  // helper methods
+  void step(Load&load,std::function<Mmvm::RunState()>const&f);
+  std::optional<Mmvm::CmdResult>startcmd(Load&load);
+  void readcmd(Load&load);
+  void reapcmd(Load&load);
+  void completecmd(Load&load);
+  void startwaiting();
+  void ontimer();
+  void armtimer();
+  void finish(Load&load,std::exception_ptr err);
+
+  // private data
+  int epfd_;
+  int timerfd_;
+  std::size_t nextid_;
+  std::map<std::size_t,std::unique_ptr<Load>>loads_;
+  std::deque<std::size_t>waiting_;      // loads waiting for a free child process slot
+};
+}
@@ -39,19 +39,21 @@ map<string,string>BasicExtractor::operator()(std::regex const&r)const{
   return ret;
 }
 map<string,string>BasicExtractor::regex(string const&rstr)const{
-  return operator()(std::regex(rstr));
+  return operator()(Query(QueryRules{{},{},{rstr}}));
+}
+// get variables selected by a query
+map<string,string>BasicExtractor::operator()(Query const&q)const{
+  map<string,string>ret;
+  q.foreach(vm()->mem(),[&](string const&name,Mmvm::Value const&value){ret.emplace_hint(ret.end(),name,vm()->val2string(value));});
+  return ret;
 }
 // get variables/values for a specific namespace
 map<string,string>BasicExtractor::ns(string const&ns)const{
-  std::regex r{ns+"\\.[a-zA-Z0-9_\\.]+"};
-  return operator()(r);
+  return operator()(Query(QueryRules{{},{ns}}));
 }
 map<string,string>BasicExtractor::ns(vector<string>const&nss)const{
-  map<string,string>ret;
-  for(auto&&n:nss){
-    for(auto&&[name,value]:ns(n))ret[name]=value;
-  }
-  return ret;
+  if(nss.empty())return map<string,string>{};
+  return operator()(Query(QueryRules{{},nss}));
 }
 // NOTE! testing
 map<string,Mmvm::Value>BasicExtractor::asValue()const{
@@ -60,4 +62,38 @@ map<string,Mmvm::Value>BasicExtractor::asValue()const{
 optional<Mmvm::Value>BasicExtractor::asValue(string const&name)const{
   return vm()->getval(name);
 }
+map<string,Mmvm::Value>BasicExtractor::asValue(Query const&q)const{
+  return q(vm()->mem());
+}
+// get a list or a map
+optional<List>BasicExtractor::asList(string const&name)const{
+  auto const&mem=vm()->mem();
+  auto it=mem.find(name);
+  if(it==mem.end()||!holds_alternative<List>(it->second))return optional<List>{};
+  return get<List>(it->second);
+}
+optional<Map>BasicExtractor::asMap(string const&name)const{
+  auto const&mem=vm()->mem();
+  auto it=mem.find(name);
+  if(it==mem.end()||!holds_alternative<Map>(it->second))return optional<Map>{};
+  return get<Map>(it->second);
+}
+// get a single element of a list or a map
+optional<string>BasicExtractor::element(string const&name,size_t ind)const{
+  auto const&mem=vm()->mem();
+  auto it=mem.find(name);
+  if(it==mem.end()||!holds_alternative<List>(it->second))return optional<string>{};
+  List const&l=get<List>(it->second);
+  if(ind>=l.size())return optional<string>{};
+  return l.str(ind);
+}
+optional<string>BasicExtractor::element(string const&name,string const&key)const{
+  auto const&mem=vm()->mem();
+  auto it=mem.find(name);
+  if(it==mem.end()||!holds_alternative<Map>(it->second))return optional<string>{};
+  auto val=get<Map>(it->second).find(key);
+  if(!val)return optional<string>{};
+  if(holds_alternative<int>(val.value()))return to_string(get<int>(val.value()));
+  return string(get<string_view>(val.value()));
+}
 }
@@ -2,6 +2,7 @@
 #pragma once
 #include "xconfig/Extractor.h"
 #include "xconfig/Mmvm.h"
+#include "xconfig/Query.h"
 #include <memory>
 #include <string>
 #include <vector>
@@ -37,6 +38,9 @@ public:
   std::map<std::string,std::string>operator()(std::regex const&r)const;
   std::map<std::string,std::string>regex(std::string const&rstr)const;
 
+  // get variables selected by a query
+  std::map<std::string,std::string>operator()(Query const&q)const;
+
   // get variables/values for a specific namespace
   std::map<std::string,std::string>ns(std::string const&ns)const;
   std::map<std::string,std::string>ns(std::vector<std::string>const&nss)const;
@@ -44,5 +48,15 @@ public:
   // NOTE! testing
   std::map<std::string,Mmvm::Value>asValue()const;
   std::optional<Mmvm::Value>asValue(std::string const&name)const;
+  std::map<std::string,Mmvm::Value>asValue(Query const&q)const;
+
+  // get a list or a map (empty if variable does not exist or has another type)
+  std::optional<List>asList(std::string const&name)const;
+  std::optional<Map>asMap(std::string const&name)const;
+
+  // get a single element of a list or a map as a string without copying the list or map
+  // (empty if variable does not exist, has another type or does not have the element)
+  std::optional<std::string>element(std::string const&name,std::size_t ind)const;
+  std::optional<std::string>element(std::string const&name,std::string const&key)const;
 };
 }
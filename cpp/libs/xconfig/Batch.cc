@@ -0,0 +1,63 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/Batch.h"
+#include "xconfig/ThreadPool.h"
+#include <future>
+#include <algorithm>
+#include <exception>
+using namespace std;
+namespace xconfig{
+
+// helper functions
+namespace{
+// take snapshot of process environment once so evaluations don't depend on the mutable process environment
+XConfigOptions batchopts(XConfigOptions const&opts){
+  XConfigOptions ret=opts;
+  if(!ret.env)ret.env=Environment();
+  ret.exportenv=false;                 // evaluations running in parallel must not write to the process environment
+  return ret;
+}
+// run a set of load functions on a thread pool and collect results
+template<typename F>
+vector<BatchResult>runbatch(vector<string>const&names,size_t nthreads,F load){
+  vector<BatchResult>ret(names.size());
+  if(names.empty())return ret;
+  ThreadPool pool(min(nthreads?nthreads:size_t(thread::hardware_concurrency()),names.size()));
+  vector<future<shared_ptr<XConfig>>>futs;
+  for(size_t i=0;i<names.size();++i)futs.push_back(pool.submit([&load,i](){return load(i);}));
+  for(size_t i=0;i<names.size();++i){
+    ret[i].name=names[i];
+    try{
+      ret[i].xfg=futs[i].get();
+    }
+    catch(exception const&e){
+      ret[i].err=e.what();
+    }
+  }
+  return ret;
+}
+}
+// compile and evaluate a batch of configuration files in parallel
+vector<BatchResult>loadbatch(vector<string>const&cfgpaths,XConfigOptions const&opts,size_t nthreads){
+  XConfigOptions xopts=batchopts(opts);
+  return runbatch(cfgpaths,nthreads,[&](size_t i){return make_shared<XConfig>(cfgpaths[i],xopts);});
+}
+// compile and evaluate a batch of configuration streams in parallel
+vector<BatchResult>loadbatch(vector<pair<istream*,string>>const&streams,XConfigOptions const&opts,size_t nthreads){
+  XConfigOptions xopts=batchopts(opts);
+  vector<string>names;
+  for(auto const&s:streams)names.push_back(s.second);
+  return runbatch(names,nthreads,[&](size_t i){return make_shared<XConfig>(*streams[i].first,streams[i].second,xopts);});
+}
+// evaluate a compiled configuration against many environments in parallel
+vector<BatchResult>evalbatch(CompiledConfig const&cfg,vector<Environment>const&envs,XConfigOptions const&opts,size_t nthreads){
+  XConfigOptions xopts=opts;
+  xopts.env.reset();                   // each evaluation sets its own environment
+  xopts.exportenv=false;
+  vector<string>names(envs.size(),cfg.name());
+  return runbatch(names,nthreads,[&](size_t i){
+    XConfigOptions iopts=xopts;
+    iopts.env=envs[i];
+    return cfg.run(iopts);
+  });
+}
+}
@@ -0,0 +1,32 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include "xconfig/XConfig.h"
+#include "xconfig/CompiledConfig.h"
+#include "xconfig/Environment.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <iosfwd>
+namespace xconfig{
+
+// result from loading one configuration in a batch
+struct BatchResult{
+  std::string name;                      // path or name of stream
+  std::shared_ptr<XConfig>xfg;           // evaluated configuration (null if loading failed)
+  std::optional<std::string>err;         // error if loading failed
+};
+// compile and evaluate a batch of configurations in parallel
+// (each configuration has its own vm and environment overlay - all overlays are copied from 'opts.env' or,
+//  if not set, from a single snapshot of the process environment taken before any configuration is evaluated)
+// (nthreads == 0 --> one thread per core)
+// (results are returned in the same order as the input)
+std::vector<BatchResult>loadbatch(std::vector<std::string>const&cfgpaths,XConfigOptions const&opts=XConfigOptions{},std::size_t nthreads=0);
+std::vector<BatchResult>loadbatch(std::vector<std::pair<std::istream*,std::string>>const&streams,XConfigOptions const&opts=XConfigOptions{},std::size_t nthreads=0);
+// evaluate a compiled configuration against many environments in parallel
+// (the program is compiled once and shared by all evaluations - each evaluation has its own vm and a copy of one of
+//  'envs' as environment overlay, 'opts.env' and 'opts.exportenv' are ignored)
+// (nthreads == 0 --> one thread per core)
+// (results are returned in the same order as 'envs')
+std::vector<BatchResult>evalbatch(CompiledConfig const&cfg,std::vector<Environment>const&envs,XConfigOptions const&opts=XConfigOptions{},std::size_t nthreads=0);
+}
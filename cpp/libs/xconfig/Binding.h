@@ -0,0 +1,141 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include "xconfig/XConfig.h"
+#include "xconfig/Mmvm.h"
+#include "xconfig/Symtab.h"
+#include <string>
+#include <vector>
+#include <set>
+#include <optional>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <variant>
+namespace xconfig{
+
+// bind configuration variables to members of a struct
+// (the struct is filled once after a configuration has been evaluated - hot code then reads plain members)
+// (supported member types: int, std::string, List, Map, std::vector<int>, std::vector<std::string>, Mmvm::Value and
+//  std::optional of these - a variable bound to a std::optional member may be missing, all other variables must exist
+//  and have the type of the member - a vector member is filled from a list whose elements all have the vector's type)
+// example:
+//   struct Db{std::string host;int port;std::optional<std::string>user;};
+//   Binding<Db>binding("db");                                  // names are relative to namespace 'db'
+//   binding.bind("host",&Db::host).bind("port",&Db::port).bind("user",&Db::user);
+//   Db db=binding.make(xfg);                                 // ...
+//   binding.refill(xfg,xfg.reload(cfgpath,opts),db);         // refill when a bound variable changed
+template<typename T>
+class Binding{
+public:
+  // ctor,assign,dtor
+  // (names of bound variables are relative to namespace 'ns' - fully qualified if 'ns' is empty)
+  explicit Binding(std::string const&ns=""):ns_(ns){}
+  Binding(Binding const&)=default;
+  Binding(Binding&&)=default;
+  Binding&operator=(Binding const&)=default;
+  Binding&operator=(Binding&&)=default;
+  ~Binding()=default;
+
+  // bind a variable to a member
+  template<typename M>
+  Binding&bind(std::string const&name,M T::*member){
+    std::string fqname=ns_.empty()?name:ns_+Symtab::NSSEP+name;
+    entries_.push_back(Entry{fqname,[member](std::string const&name,Mmvm::Value const*val,T&obj){
+      return assign(name,val,obj.*member);
+    }});
+    names_.insert(fqname);
+    return*this;
+  }
+  // fill an object from a configuration
+  // (throws std::runtime_error listing all variables which are missing or have the wrong type - 'obj' is then unchanged)
+  void fill(XConfig const&xfg,T&obj)const{
+    auto const&mem=xfg.basicx().vm()->mem();
+    T tmp(obj);
+    std::string errs;
+    for(auto const&entry:entries_){
+      auto it=mem.find(entry.name);
+      auto err=entry.assign(entry.name,it==mem.end()?nullptr:&it->second,tmp);
+      if(err)errs+=(errs.empty()?"":", ")+err.value();
+    }
+    if(!errs.empty())throw std::runtime_error("failed binding configuration variables: "+errs);
+    obj=std::move(tmp);
+  }
+  T make(XConfig const&xfg)const{
+    T ret{};
+    fill(xfg,ret);
+    return ret;
+  }
+  // fill an object again if a bound variable is in 'changed' (as returned by XConfig::reload(...))
+  // (returns true if object was filled)
+  bool refill(XConfig const&xfg,std::vector<std::string>const&changed,T&obj)const{
+    for(auto const&name:changed){
+      if(names_.count(name)){
+        fill(xfg,obj);
+        return true;
+      }
+    }
+    return false;
+  }
+  // fully qualified names of bound variables
+  std::set<std::string>const&names()const noexcept{return names_;}
+private:
+  // a bound member
+  // ('assign' returns an error if value is missing or has wrong type)
+  struct Entry{
+    std::string name;
+    std::function<std::optional<std::string>(std::string const&,Mmvm::Value const*,T&)>assign;
+  };
+  // check if a type is a std::optional
+  template<typename M>struct isoptional:std::false_type{};
+  template<typename M>struct isoptional<std::optional<M>>:std::true_type{};
+  template<typename M>struct unsupported:std::false_type{};
+
+  // assign a value to a member (val == nullptr --> variable does not exist)
+  template<typename M>
+  static std::optional<std::string>assign(std::string const&name,Mmvm::Value const*val,M&dst){
+    if constexpr(isoptional<M>::value){
+      if(!val){
+        dst.reset();
+        return std::nullopt;
+      }
+      typename M::value_type tmp;
+      auto err=assign(name,val,tmp);
+      if(!err)dst=std::move(tmp);
+      return err;
+    }else{
+      if(!val)return "'"+name+"' does not exist";
+      if constexpr(std::is_same_v<M,Mmvm::Value>){
+        dst=*val;
+      }else if constexpr(std::is_same_v<M,std::string>||std::is_same_v<M,int>||std::is_same_v<M,List>||std::is_same_v<M,Map>){
+        if(!std::holds_alternative<M>(*val))return "'"+name+"' is "+typenameof(*val)+" - expected "+typenameof(Mmvm::Value(M{}));
+        dst=std::get<M>(*val);
+      }else if constexpr(std::is_same_v<M,std::vector<std::string>>||std::is_same_v<M,std::vector<int>>){
+        using E=typename M::value_type;
+        if(!std::holds_alternative<List>(*val))return "'"+name+"' is "+typenameof(*val)+" - expected a list";
+        List const&l=std::get<List>(*val);
+        M tmp;
+        tmp.reserve(l.size());
+        for(std::size_t i=0;i<l.size();++i){
+          if(l.isint(i)!=std::is_same_v<E,int>)return "'"+name+"' has an element which is not "+typenameof(Mmvm::Value(E{}));
+          if constexpr(std::is_same_v<E,int>)tmp.push_back(l.getint(i));
+          else tmp.emplace_back(l.getstring(i));
+        }
+        dst=std::move(tmp);
+      }else{
+        static_assert(unsupported<M>::value,"member type must be int, std::string, List, Map, std::vector<int>, "
+                                            "std::vector<std::string>, Mmvm::Value or std::optional of these");
+      }
+      return std::nullopt;
+    }
+  }
+  // type of a value with an article (used in error messages)
+  static std::string typenameof(Mmvm::Value const&val){
+    static char const*const names[]={"an int","a string","a list","a map"};
+    return names[val.index()];
+  }
+  // private data
+  std::string ns_;
+  std::vector<Entry>entries_;
+  std::set<std::string>names_;
+};
+}
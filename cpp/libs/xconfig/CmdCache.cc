@@ -0,0 +1,145 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/CmdCache.h"
+#include "xconfig/Environment.h"
+#include "xconfig/stringutils.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/stat.h>
+using namespace std;
+namespace xconfig{
+
+// helpers
+namespace{
+// magic first line of a cache file
+string const cachemagic="xconfig-cache 1";
+
+// current time as seconds since epoch
+long long nowsec(){
+  return chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+// check that a directory or file is owned by the current user and not a symbolic link
+bool ownedbyuser(string const&path,struct stat&st){
+  return lstat(path.c_str(),&st)==0&&st.st_uid==geteuid();
+}
+}
+// ctor
+CmdCache::CmdCache(string const&dir,Mode mode):dir_(dir),mode_(mode){
+}
+// get cached output for a key
+optional<string>CmdCache::get(string const&key,chrono::seconds ttl)const{
+  if(mode_!=Mode::use)return nullopt;
+
+  // only files written by the current user into a private directory are used
+  struct stat st;
+  string path=keypath(key);
+  if(!checkdir(false)||!ownedbyuser(path,st)||!S_ISREG(st.st_mode))return nullopt;
+
+  // read cache file: <magic>\n<created>\n<keylen>\n<key><output>
+  // (a file created in the future or with a key of the wrong length is corrupt)
+  ifstream is(path,ios::binary);
+  if(!is)return nullopt;
+  string magic;
+  long long created;
+  size_t keylen;
+  if(!getline(is,magic)||magic!=cachemagic)return nullopt;
+  if(!(is>>created>>keylen)||is.get()!='\n')return nullopt;
+  long long now=nowsec();
+  if(created>now||now-created>=ttl.count())return nullopt;
+  if(keylen!=key.size())return nullopt;
+
+  // check key is identical (protects against hash collisions)
+  string storedkey(keylen,'\0');
+  if(!is.read(storedkey.data(),keylen)||storedkey!=key)return nullopt;
+
+  // rest of file is output
+  stringstream str;
+  str<<is.rdbuf();
+  return str.str();
+}
+// write output for a key to cache
+// (written to a temporary file which is renamed so concurrent readers never see a partial file)
+void CmdCache::put(string const&key,string const&output)const{
+  if(mode_==Mode::off)return;
+  static atomic<unsigned long>seqno{0};
+  if(!checkdir(true))return;
+  string path=keypath(key);
+  string tmppath=path+".tmp."+to_string(getpid())+"."+to_string(seqno++);
+  {
+    // (file is made readable only by the owner before output is written to it)
+    ofstream os(tmppath,ios::binary|ios::trunc);
+    if(!os)return;
+    error_code ec;
+    filesystem::permissions(tmppath,filesystem::perms::owner_read|filesystem::perms::owner_write,ec);
+    if(ec){
+      os.close();
+      std::remove(tmppath.c_str());
+      return;
+    }
+    os<<cachemagic<<"\n"<<nowsec()<<"\n"<<key.size()<<"\n"<<key<<output;
+    if(!os){
+      std::remove(tmppath.c_str());
+      return;
+    }
+  }
+  if(std::rename(tmppath.c_str(),path.c_str())!=0)std::remove(tmppath.c_str());
+}
+// getters
+string const&CmdCache::dir()const noexcept{return dir_;}
+CmdCache::Mode CmdCache::mode()const noexcept{return mode_;}
+
+// create key for a command
+string CmdCache::makekey(string const&cmd,Environment const&env){
+  string ret=cmd;
+  ret+='\0';
+
+  // current directory
+  error_code ec;
+  ret+=filesystem::current_path(ec).string();
+  ret+='\0';
+
+  // PATH + environment variables referenced in command ($xxx or ${xxx})
+  auto addenv=[&ret,&env](string const&name){
+    string const*val=env.get(name);
+    ret+=name;
+    ret+=val?"="+*val:"";
+    ret+='\0';
+  };
+  addenv("PATH");
+  for(auto const&name:envrefs(cmd))addenv(name);
+  return ret;
+}
+// default cache directory
+optional<string>CmdCache::defaultdir(Environment const&env){
+  string const*xdgcache=env.get("XDG_CACHE_HOME");
+  if(xdgcache&&!xdgcache->empty())return *xdgcache+"/xconfig";
+  string const*home=env.get("HOME");
+  if(home&&!home->empty())return *home+"/.cache/xconfig";
+  return nullopt;
+}
+// check that cache directory is private to the current user (optionally creating it)
+// (a directory owned by the current user is made private if it is not - a directory owned by someone else is not used)
+bool CmdCache::checkdir(bool create)const{
+  if(create){
+    error_code ec;
+    filesystem::path dir(dir_);
+    if(dir.has_parent_path())filesystem::create_directories(dir.parent_path(),ec);
+    if(::mkdir(dir_.c_str(),S_IRWXU)!=0&&errno!=EEXIST)return false;
+  }
+  struct stat st;
+  if(!ownedbyuser(dir_,st)||!S_ISDIR(st.st_mode))return false;
+  return (st.st_mode&(S_IRWXG|S_IRWXO))==0||::chmod(dir_.c_str(),S_IRWXU)==0;
+}
+// get path of file for a key
+string CmdCache::keypath(string const&key)const{
+  stringstream str;
+  str<<dir_<<"/"<<hex<<setfill('0')<<setw(16)<<fnv1a(key);
+  return str.str();
+}
+}
@@ -0,0 +1,59 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include <string>
+#include <optional>
+#include <chrono>
+namespace xconfig{
+
+// forward decl
+class Environment;
+
+// on-disk cache of command output shared between runs
+// (one file per command - file contains creation time, key and output)
+// (directory and files are only accessible by the current user - a directory or file owned by someone else is not used)
+class CmdCache{
+public:
+  // how cache is used
+  enum class Mode{
+    off=0,                             // cache is not used
+    use=1,                             // use cached output if fresh, else execute command and cache output
+    refresh=2                          // always execute command and cache output
+  };
+  // ctor,assign,dtor
+  CmdCache(std::string const&dir,Mode mode);
+  CmdCache(CmdCache const&)=default;
+  CmdCache(CmdCache&&)=default;
+  CmdCache&operator=(CmdCache const&)=default;
+  CmdCache&operator=(CmdCache&&)=default;
+  ~CmdCache()=default;
+
+  // get output of a command if it was cached less than 'ttl' ago
+  std::optional<std::string>get(std::string const&key,std::chrono::seconds ttl)const;
+
+  // cache output of a command
+  // (cache is best effort - errors are ignored)
+  void put(std::string const&key,std::string const&output)const;
+
+  // getters
+  std::string const&dir()const noexcept;
+  Mode mode()const noexcept;
+
+  // create key for a command
+  // (key = command text + current directory + PATH + environment variables referenced in command text)
+  static std::string makekey(std::string const&cmd,Environment const&env);
+
+  // default cache directory: $XDG_CACHE_HOME/xconfig or $HOME/.cache/xconfig
+  // (std::nullopt if neither is set - commands are then not cached)
+  static std::optional<std::string>defaultdir(Environment const&env);
+private:
+  // get path of file for a key
+  std::string keypath(std::string const&key)const;
+
+  // check that cache directory exists, is owned by the current user and is private
+  bool checkdir(bool create)const;
+
+  // private data
+  std::string dir_;
+  Mode mode_;
+};
+}
@@ -0,0 +1,37 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/CodeQueue.h"
+using namespace std;
+namespace xconfig{
+
+// ctor
+CodeQueue::CodeQueue():closed_(false){
+}
+// add a block
+bool CodeQueue::push(CodeBlock block){
+  {
+    lock_guard<mutex>lock(mtx_);
+    if(closed_)return false;
+    blocks_.push_back(move(block));
+  }
+  cond_.notify_one();
+  return true;
+}
+// get next block
+optional<CodeBlock>CodeQueue::pop(){
+  unique_lock<mutex>lock(mtx_);
+  cond_.wait(lock,[this](){return closed_||!blocks_.empty();});
+  if(closed_)return nullopt;
+  CodeBlock ret=move(blocks_.front());
+  blocks_.pop_front();
+  return ret;
+}
+// close queue
+void CodeQueue::close(){
+  {
+    lock_guard<mutex>lock(mtx_);
+    closed_=true;
+    blocks_.clear();
+  }
+  cond_.notify_all();
+}
+}
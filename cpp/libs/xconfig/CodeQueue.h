@@ -0,0 +1,47 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include "xconfig/Mmvm.h"
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+namespace xconfig{
+
+// block of validated code ending at a statement boundary
+// (addresses in 'stmts' and 'lines' are absolute addresses in the complete program)
+struct CodeBlock{
+  std::vector<Mmvm::ProgElement>code;
+  std::vector<Mmvm::Stmt>stmts;
+  std::vector<Mmvm::LineEntry>lines;
+  std::optional<std::size_t>maxdepth;   // max stack depth of code (only set if code has been verified)
+};
+// queue of code blocks passed from the compiler to a vm running on another thread
+// (blocks are pushed in program order - the last block of a program contains the 'stop' instruction)
+class CodeQueue{
+public:
+  // ctor,assign,dtor
+  CodeQueue();
+  CodeQueue(CodeQueue const&)=delete;
+  CodeQueue(CodeQueue&&)=delete;
+  CodeQueue&operator=(CodeQueue const&)=delete;
+  CodeQueue&operator=(CodeQueue&&)=delete;
+  ~CodeQueue()=default;
+
+  // add a block (returns false if queue has been closed)
+  bool push(CodeBlock block);
+
+  // get next block - waits until a block is available
+  // (returns std::nullopt if queue has been closed)
+  std::optional<CodeBlock>pop();
+
+  // close queue - blocks not yet consumed are dropped
+  // (called when compilation or execution fails)
+  void close();
+private:
+  std::deque<CodeBlock>blocks_;
+  std::mutex mtx_;
+  std::condition_variable cond_;
+  bool closed_;
+};
+}
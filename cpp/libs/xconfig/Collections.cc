@@ -0,0 +1,218 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/Collections.h"
+#include "xconfig/MemStats.h"
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
+using namespace std;
+namespace xconfig{
+
+// helpers
+namespace{
+// write a string as a double quoted literal
+void writequoted(ostream&os,string_view str){
+  os<<'"';
+  for(char c:str){
+    if(c=='"'||c=='\\')os<<'\\';
+    os<<c;
+  }
+  os<<'"';
+}
+// write an element using literal syntax
+void writeelem(ostream&os,List::Elem const&el){
+  if(holds_alternative<int>(el))os<<get<int>(el);
+  else writequoted(os,get<string_view>(el));
+}
+}
+// ---------------- List
+// size
+size_t List::size()const noexcept{
+  return slots_.size();
+}
+bool List::empty()const noexcept{
+  return slots_.empty();
+}
+size_t List::heapbytes()const noexcept{
+  return slots_.capacity()*sizeof(Slot)+xconfig::heapbytes(chars_);
+}
+// access elements
+List::Elem List::operator[](size_t i)const{
+  Slot const&s=slot(i);
+  if(s.isint)return s.ival;
+  return string_view(chars_).substr(s.off,s.len);
+}
+bool List::isint(size_t i)const{
+  return slot(i).isint;
+}
+int List::getint(size_t i)const{
+  return get<int>((*this)[i]);
+}
+string_view List::getstring(size_t i)const{
+  return get<string_view>((*this)[i]);
+}
+string List::str(size_t i)const{
+  Slot const&s=slot(i);
+  if(s.isint)return to_string(s.ival);
+  return chars_.substr(s.off,s.len);
+}
+// add elements
+void List::reserve(size_t nelems,size_t nchars){
+  slots_.reserve(nelems);
+  chars_.reserve(nchars);
+}
+void List::push_back(int val){
+  slots_.push_back(Slot{0,0,val,true});
+}
+void List::push_back(string_view val){
+  if(chars_.size()+val.size()>numeric_limits<uint32_t>::max())throw length_error("list too large");
+  slots_.push_back(Slot{static_cast<uint32_t>(chars_.size()),static_cast<uint32_t>(val.size()),0,false});
+  chars_.append(val);
+}
+void List::push_back(Elem const&val){
+  visit([this](auto const&v){push_back(v);},val);
+}
+void List::append(List const&other){
+  if(chars_.size()+other.chars_.size()>numeric_limits<uint32_t>::max())throw length_error("list too large");
+  uint32_t off=chars_.size();
+  slots_.reserve(slots_.size()+other.slots_.size());
+  for(Slot s:other.slots_){
+    if(!s.isint)s.off+=off;
+    slots_.push_back(s);
+  }
+  chars_.append(other.chars_);
+}
+// list as a string
+string List::str()const{
+  string ret;
+  ret.reserve(chars_.size()+2*slots_.size());
+  for(size_t i=0;i<slots_.size();++i){
+    if(i)ret+=' ';
+    Slot const&s=slots_[i];
+    if(s.isint)ret+=to_string(s.ival);
+    else ret.append(chars_,s.off,s.len);
+  }
+  return ret;
+}
+// compare
+bool List::operator==(List const&other)const{
+  if(slots_.size()!=other.slots_.size())return false;
+  for(size_t i=0;i<slots_.size();++i){
+    if((*this)[i]!=other[i])return false;
+  }
+  return true;
+}
+bool List::operator!=(List const&other)const{
+  return!(*this==other);
+}
+bool List::operator<(List const&other)const{
+  size_t n=min(slots_.size(),other.slots_.size());
+  for(size_t i=0;i<n;++i){
+    Elem e1=(*this)[i];
+    Elem e2=other[i];
+    if(e1!=e2)return e1<e2;
+  }
+  return slots_.size()<other.slots_.size();
+}
+// get slot of an element
+List::Slot const&List::slot(size_t i)const{
+  if(i>=slots_.size())throw out_of_range("list index "s+to_string(i)+" out of range (size: "+to_string(slots_.size())+")");
+  return slots_[i];
+}
+// ---------------- Map
+// size
+size_t Map::size()const noexcept{
+  return order_.size();
+}
+bool Map::empty()const noexcept{
+  return order_.empty();
+}
+size_t Map::heapbytes()const noexcept{
+  return keys_.heapbytes()+values_.heapbytes()+order_.capacity()*sizeof(uint32_t);
+}
+// access entries in key order
+string_view Map::key(size_t i)const{
+  if(i>=order_.size())throw out_of_range("map index "s+to_string(i)+" out of range (size: "+to_string(order_.size())+")");
+  return keys_.getstring(order_[i]);
+}
+List::Elem Map::value(size_t i)const{
+  if(i>=order_.size())throw out_of_range("map index "s+to_string(i)+" out of range (size: "+to_string(order_.size())+")");
+  return values_[order_[i]];
+}
+// lookup value of a key
+optional<List::Elem>Map::find(string_view key)const{
+  size_t i=lowerbound(key);
+  if(i==order_.size()||keys_.getstring(order_[i])!=key)return nullopt;
+  return values_[order_[i]];
+}
+// add an entry
+void Map::reserve(size_t nentries,size_t nchars){
+  keys_.reserve(nentries,nchars);
+  values_.reserve(nentries,0);
+  order_.reserve(nentries);
+}
+bool Map::insert(string_view key,List::Elem const&val){
+  size_t i=lowerbound(key);
+  if(i<order_.size()&&keys_.getstring(order_[i])==key)return false;
+  keys_.push_back(key);
+  values_.push_back(val);
+  order_.insert(order_.begin()+i,static_cast<uint32_t>(keys_.size()-1));
+  return true;
+}
+// map as a string
+string Map::str()const{
+  string ret;
+  for(size_t i=0;i<order_.size();++i){
+    if(i)ret+=' ';
+    ret.append(keys_.getstring(order_[i]));
+    ret+='=';
+    ret+=values_.str(order_[i]);
+  }
+  return ret;
+}
+// compare
+bool Map::operator==(Map const&other)const{
+  if(order_.size()!=other.order_.size())return false;
+  for(size_t i=0;i<order_.size();++i){
+    if(key(i)!=other.key(i)||value(i)!=other.value(i))return false;
+  }
+  return true;
+}
+bool Map::operator!=(Map const&other)const{
+  return!(*this==other);
+}
+bool Map::operator<(Map const&other)const{
+  size_t n=min(order_.size(),other.order_.size());
+  for(size_t i=0;i<n;++i){
+    if(key(i)!=other.key(i))return key(i)<other.key(i);
+    List::Elem v1=value(i);
+    List::Elem v2=other.value(i);
+    if(v1!=v2)return v1<v2;
+  }
+  return order_.size()<other.order_.size();
+}
+// index in 'order_' of first key not less than 'key'
+size_t Map::lowerbound(string_view key)const{
+  auto it=lower_bound(order_.begin(),order_.end(),key,[this](uint32_t i,string_view k){return keys_.getstring(i)<k;});
+  return it-order_.begin();
+}
+// ---------------- print
+ostream&operator<<(ostream&os,List const&l){
+  os<<'[';
+  for(size_t i=0;i<l.size();++i){
+    if(i)os<<',';
+    writeelem(os,l[i]);
+  }
+  return os<<']';
+}
+ostream&operator<<(ostream&os,Map const&m){
+  os<<'{';
+  for(size_t i=0;i<m.size();++i){
+    if(i)os<<',';
+    writequoted(os,m.key(i));
+    os<<':';
+    writeelem(os,m.value(i));
+  }
+  return os<<'}';
+}
+}
@@ -0,0 +1,117 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <variant>
+#include <optional>
+#include <cstdint>
+#include <iosfwd>
+namespace xconfig{
+
+// list of scalar values (ints and strings) stored contiguously
+// (characters of all string elements are stored back to back in a single buffer - an element is a fixed size slot
+//  holding either an int or an offset/length into the buffer, so a list is two allocations regardless of its size)
+class List{
+public:
+  // an element (string elements refer into the list and are only valid while the list is not modified)
+  using Elem=std::variant<int,std::string_view>;
+
+  // ctor,assign,dtor
+  List()=default;
+  List(List const&)=default;
+  List(List&&)=default;
+  List&operator=(List const&)=default;
+  List&operator=(List&&)=default;
+  ~List()=default;
+
+  // size
+  // (heapbytes: heap memory owned by the list)
+  std::size_t size()const noexcept;
+  bool empty()const noexcept;
+  std::size_t heapbytes()const noexcept;
+
+  // access elements (index is checked - throws std::out_of_range)
+  Elem operator[](std::size_t i)const;
+  bool isint(std::size_t i)const;
+  int getint(std::size_t i)const;                       // (throws std::bad_variant_access if element is a string)
+  std::string_view getstring(std::size_t i)const;       // (throws std::bad_variant_access if element is an int)
+  std::string str(std::size_t i)const;                  // element converted to a string
+
+  // add elements
+  void reserve(std::size_t nelems,std::size_t nchars);
+  void push_back(int val);
+  void push_back(std::string_view val);
+  void push_back(Elem const&val);
+  void append(List const&other);
+
+  // list as a string - elements separated by a single blank
+  // (same as the blank separated strings lists were encoded as before lists existed)
+  std::string str()const;
+
+  // compare
+  bool operator==(List const&other)const;
+  bool operator!=(List const&other)const;
+  bool operator<(List const&other)const;              // (lexicographical - ints are ordered before strings)
+private:
+  // an element
+  struct Slot{
+    std::uint32_t off;                  // offset of string in 'chars_'
+    std::uint32_t len;                  // length of string
+    int ival;                           // value of int
+    bool isint;                         // true if element is an int
+  };
+  Slot const&slot(std::size_t i)const;
+
+  // private data
+  std::vector<Slot>slots_;              // elements
+  std::string chars_;                   // characters of all string elements
+};
+// map from string keys to scalar values
+// (keys and values are stored in two lists in insertion order, an index vector keeps the entries sorted on key)
+class Map{
+public:
+  // ctor,assign,dtor
+  Map()=default;
+  Map(Map const&)=default;
+  Map(Map&&)=default;
+  Map&operator=(Map const&)=default;
+  Map&operator=(Map&&)=default;
+  ~Map()=default;
+
+  // size
+  // (heapbytes: heap memory owned by the map)
+  std::size_t size()const noexcept;
+  bool empty()const noexcept;
+  std::size_t heapbytes()const noexcept;
+
+  // access entries in key order (index is checked - throws std::out_of_range)
+  std::string_view key(std::size_t i)const;
+  List::Elem value(std::size_t i)const;
+
+  // lookup value of a key (binary search)
+  std::optional<List::Elem>find(std::string_view key)const;
+
+  // add an entry (returns false if key already exists - map is then unchanged)
+  void reserve(std::size_t nentries,std::size_t nchars);
+  bool insert(std::string_view key,List::Elem const&val);
+
+  // map as a string - 'key=value' entries in key order separated by a single blank
+  std::string str()const;
+
+  // compare
+  bool operator==(Map const&other)const;
+  bool operator!=(Map const&other)const;
+  bool operator<(Map const&other)const;               // (lexicographical on entries in key order)
+private:
+  std::size_t lowerbound(std::string_view key)const;
+
+  // private data
+  List keys_;                           // keys in insertion order
+  List values_;                         // values in insertion order
+  std::vector<std::uint32_t>order_;     // indices into 'keys_' and 'values_' sorted on key
+};
+// print lists and maps using literal syntax, e.g. '["a",1]' and '{"a":1}'
+std::ostream&operator<<(std::ostream&os,List const&l);
+std::ostream&operator<<(std::ostream&os,Map const&m);
+}
@@ -0,0 +1,25 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/CompiledConfig.h"
+#include <fstream>
+#include <stdexcept>
+using namespace std;
+namespace xconfig{
+
+// ctors
+CompiledConfig::CompiledConfig(string const&cfgpath):name_(cfgpath){
+  ifstream is(cfgpath.c_str(),ifstream::in);
+  if(!is)throw runtime_error("failed opening file: "s+cfgpath+" for reading");
+  vm_=XConfig::compile(is,cfgpath);
+}
+CompiledConfig::CompiledConfig(istream&is,string const&name):name_(name),vm_(XConfig::compile(is,name)){
+}
+CompiledConfig::CompiledConfig(EmbeddedProgram const&prog):name_(prog.name),vm_(XConfig::compile(prog)){
+}
+// evaluate configuration
+shared_ptr<XConfig>CompiledConfig::run(XConfigOptions const&opts)const{
+  return XConfig::runcompiled(*vm_,name_,opts);
+}
+// getters
+string const&CompiledConfig::name()const noexcept{return name_;}
+Mmvm const&CompiledConfig::vm()const noexcept{return*vm_;}
+}
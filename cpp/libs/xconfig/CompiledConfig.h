@@ -0,0 +1,38 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include "xconfig/XConfig.h"
+#include "xconfig/Mmvm.h"
+#include "xconfig/EmbeddedProgram.h"
+#include <string>
+#include <memory>
+#include <iosfwd>
+namespace xconfig{
+
+// a configuration compiled once and evaluated any number of times
+// (the validated program is immutable and shared by all evaluations - each evaluation runs in its own vm against its own
+//  environment overlay, so evaluating a configuration for many environments costs one compilation plus one run each)
+// (run(...) is thread safe - evaluations of the same compiled configuration may run concurrently, see 'evalbatch(...)')
+class CompiledConfig{
+public:
+  // ctor,assign,dtor
+  // (throws std::runtime_error if the configuration cannot be compiled)
+  explicit CompiledConfig(std::string const&cfgpath);
+  CompiledConfig(std::istream&is,std::string const&name);
+  explicit CompiledConfig(EmbeddedProgram const&prog);
+  CompiledConfig(CompiledConfig const&)=default;
+  CompiledConfig(CompiledConfig&&)=default;
+  CompiledConfig&operator=(CompiledConfig const&)=default;
+  CompiledConfig&operator=(CompiledConfig&&)=default;
+  ~CompiledConfig()=default;
+
+  // evaluate configuration against 'opts.env' (default: snapshot of process environment)
+  std::shared_ptr<XConfig>run(XConfigOptions const&opts=XConfigOptions{})const;
+
+  // getters
+  std::string const&name()const noexcept;
+  Mmvm const&vm()const noexcept;
+private:
+  std::string name_;
+  std::shared_ptr<Mmvm const>vm_;       // compiled program (never run)
+};
+}
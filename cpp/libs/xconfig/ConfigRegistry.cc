@@ -0,0 +1,140 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/ConfigRegistry.h"
+#include "xconfig/Environment.h"
+#include "xconfig/stringutils.h"
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <sys/stat.h>
+using namespace std;
+namespace xconfig{
+
+// process wide registry
+ConfigRegistry&ConfigRegistry::global(){
+  static ConfigRegistry reg;
+  return reg;
+}
+// compare file ids
+bool ConfigRegistry::FileId::operator==(FileId const&other)const{
+  return dev==other.dev&&ino==other.ino&&size==other.size&&mtimens==other.mtimens;
+}
+// ctor
+ConfigRegistry::ConfigRegistry():nloads_(0){
+}
+// get evaluated configuration
+shared_ptr<XConfig const>ConfigRegistry::get(string const&cfgpath,XConfigOptions const&opts){
+  // different paths to the same file share a configuration
+  error_code ec;
+  string path=filesystem::weakly_canonical(cfgpath,ec).string();
+  if(ec||path.empty())path=cfgpath;
+  FileId id=fileid(path);
+
+  // configuration is evaluated against the environment it is keyed by
+  XConfigOptions evalopts=opts;
+  if(!evalopts.env)evalopts.env=Environment();
+  string key=makekey(path,evalopts);
+
+  // use loaded configuration or wait for configuration being loaded
+  unique_lock<mutex>lock(mtx_);
+  Entry&entry=entries_[key];
+  if(entry.loading.valid()){
+    auto loading=entry.loading;
+    lock.unlock();
+    return loading.get();
+  }
+  auto prev=entry.cfg.lock();
+  if(prev&&entry.fileid==id)return prev;
+
+  // load configuration - callers asking for it while it is loaded wait for it
+  // (entry is not removed while it is being loaded and is only modified by the loading caller)
+  promise<shared_ptr<XConfig const>>prom;
+  entry.loading=prom.get_future().share();
+  uint64_t prevhash=entry.hash;
+  purge();
+  lock.unlock();
+  try{
+    // file is identified before it is read - a change while it is read is detected by the next call
+    FileId newid=fileid(path);
+    ifstream is(path.c_str(),ifstream::in);
+    if(!is)throw runtime_error("failed opening file: "s+path+" for reading");
+    string src(istreambuf_iterator<char>(is),istreambuf_iterator<char>{});
+    uint64_t hash=fnv1a(src);
+
+    // a file which was touched without changing its content is not evaluated again
+    shared_ptr<XConfig const>cfg=prev&&hash==prevhash?prev:nullptr;
+    if(!cfg){
+      istringstream srcis(std::move(src));
+      cfg=make_shared<XConfig>(srcis,path,evalopts);
+    }
+    lock.lock();
+    if(cfg!=prev)++nloads_;
+    entry.cfg=cfg;
+    entry.fileid=newid;
+    entry.hash=hash;
+    entry.loading=shared_future<shared_ptr<XConfig const>>{};
+    lock.unlock();
+    prom.set_value(cfg);
+    return cfg;
+  }
+  catch(...){
+    if(!lock.owns_lock())lock.lock();
+    entry.loading=shared_future<shared_ptr<XConfig const>>{};
+    if(entry.cfg.expired())entries_.erase(key);
+    lock.unlock();
+    prom.set_exception(current_exception());
+    throw;
+  }
+}
+// #of configurations in use or being loaded
+size_t ConfigRegistry::size(){
+  lock_guard<mutex>lock(mtx_);
+  purge();
+  return entries_.size();
+}
+// #of evaluations
+size_t ConfigRegistry::nloads(){
+  lock_guard<mutex>lock(mtx_);
+  return nloads_;
+}
+// get file id of configuration file
+ConfigRegistry::FileId ConfigRegistry::fileid(string const&path){
+  struct stat st;
+  if(::stat(path.c_str(),&st)<0)throw runtime_error("failed stat on file: "s+path+", error: "+strerror(errno));
+  return FileId{st.st_dev,st.st_ino,st.st_size,static_cast<long long>(st.st_mtim.tv_sec)*1000000000LL+st.st_mtim.tv_nsec};
+}
+// create key for a configuration
+// (options not affecting the result of an evaluation - tracer, pipelined and compile threads - are not part of the key)
+string ConfigRegistry::makekey(string const&path,XConfigOptions const&opts){
+  string ret=path;
+  auto add=[&ret](string const&str){
+    ret+='\0';
+    ret+=str;
+  };
+  auto addopt=[&add](bool set,string const&str){add(set?"="s+str:""s);};
+  add(opts.exportenv?"export":"");
+  addopt(opts.cmdtimeout.has_value(),opts.cmdtimeout?to_string(opts.cmdtimeout.value().count()):"");
+  addopt(opts.deadline.has_value(),opts.deadline?to_string(opts.deadline.value().count()):"");
+  add(to_string(static_cast<int>(opts.shellmode)));
+  add(to_string(static_cast<int>(opts.cachemode)));
+  addopt(opts.cachedir.has_value(),opts.cachedir.value_or(""));
+  addopt(opts.cachettl.has_value(),opts.cachettl?to_string(opts.cachettl.value().count()):"");
+  vector<string>vars=opts.env.value().envp();
+  sort(vars.begin(),vars.end());
+  for(auto const&var:vars)add(var);
+  return ret;
+}
+// remove configurations no longer in use
+// (called with lock held)
+void ConfigRegistry::purge(){
+  for(auto it=entries_.begin();it!=entries_.end();){
+    if(!it->second.loading.valid()&&it->second.cfg.expired())it=entries_.erase(it);
+    else ++it;
+  }
+}
+}
@@ -0,0 +1,71 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include "xconfig/XConfig.h"
+#include <string>
+#include <map>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <cstdint>
+#include <sys/types.h>
+namespace xconfig{
+
+// registry of evaluated configurations shared between components of a process
+// (a configuration file is evaluated once per set of options - all callers asking for the same file and options get the
+//  same immutable configuration, concurrent requests for a configuration being loaded wait for that load)
+// (the registry does not own configurations - a configuration is freed when the last caller releases it and is evaluated
+//  again the next time it is requested)
+// (a configuration is evaluated again when the file has changed - the file is hashed only if its modification time, size
+//  or inode changed, so touching a file does not re-evaluate it - changes in command output are not detected)
+// (the registry is thread safe)
+class ConfigRegistry{
+public:
+  // process wide registry
+  static ConfigRegistry&global();
+
+  // ctor,assign,dtor
+  ConfigRegistry();
+  ConfigRegistry(ConfigRegistry const&)=delete;
+  ConfigRegistry(ConfigRegistry&&)=delete;
+  ConfigRegistry&operator=(ConfigRegistry const&)=delete;
+  ConfigRegistry&operator=(ConfigRegistry&&)=delete;
+  ~ConfigRegistry()=default;
+
+  // get evaluated configuration, evaluating it if it is not loaded or if the file has changed
+  // (configurations are keyed by canonical path and by the options affecting the result of an evaluation - environment
+  //  (default: snapshot of process environment), command limits, shell mode, cache settings and 'exportenv')
+  // (an error from evaluating a configuration is reported to all callers waiting for it - the next call tries again)
+  std::shared_ptr<XConfig const>get(std::string const&cfgpath,XConfigOptions const&opts=XConfigOptions{});
+
+  // #of configurations in use or being loaded
+  std::size_t size();
+
+  // #of times a configuration file has been evaluated
+  std::size_t nloads();
+private:
+  // identity of configuration file when it was evaluated
+  struct FileId{
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    long long mtimens;
+    bool operator==(FileId const&other)const;
+  };
+  // a configuration loaded or being loaded
+  struct Entry{
+    std::weak_ptr<XConfig const>cfg;    // evaluated configuration (expired when no longer used)
+    FileId fileid{};                    // file identity and hash of file content when configuration was evaluated
+    std::uint64_t hash=0;
+    std::shared_future<std::shared_ptr<XConfig const>>loading;   // valid while configuration is being loaded
+  };
+  // helper methods
+  static FileId fileid(std::string const&path);
+  static std::string makekey(std::string const&path,XConfigOptions const&opts);
+  void purge();
+
+  // private data
+  std::mutex mtx_;
+  std::map<std::string,Entry>entries_;  // key --> configuration
+  std::size_t nloads_;
+};
+}
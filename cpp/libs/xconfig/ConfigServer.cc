@@ -0,0 +1,336 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/ConfigServer.h"
+#include "xconfig/procutils.h"
+#include "xconfig/Snapshot.h"
+#include <sstream>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+using namespace std;
+namespace xconfig{
+
+// helpers
+namespace{
+// max #of compiled queries kept by server
+constexpr size_t maxquerycache=1024;
+
+// max #of bytes buffered for a request not yet terminated by an empty line
+constexpr size_t maxrequestsize=1<<20;
+
+// create unix domain socket address
+sockaddr_un makeaddr(string const&sockpath){
+  sockaddr_un addr;
+  memset(&addr,0,sizeof(addr));
+  addr.sun_family=AF_UNIX;
+  if(sockpath.size()>=sizeof(addr.sun_path))throw runtime_error("socket path too long: "s+sockpath);
+  strncpy(addr.sun_path,sockpath.c_str(),sizeof(addr.sun_path)-1);
+  return addr;
+}
+// write all data to a socket
+// (MSG_NOSIGNAL --> a closed peer shows up as EPIPE instead of SIGPIPE)
+bool sendall(int fd,string const&data){
+  char const*p=data.data();
+  size_t nleft=data.size();
+  while(nleft>0){
+    ssize_t nwritten=send(fd,p,nleft,MSG_NOSIGNAL);
+    if(nwritten<0&&errno==EINTR)continue;
+    if(nwritten<0)return false;
+    p+=nwritten;
+    nleft-=nwritten;
+  }
+  return true;
+}
+// write as much buffered output as a non-blocking socket accepts
+// (returns false if the peer is gone)
+bool sendbuffered(int fd,string&out){
+  size_t nsent=0;
+  while(nsent<out.size()){
+    ssize_t nwritten=send(fd,out.data()+nsent,out.size()-nsent,MSG_NOSIGNAL);
+    if(nwritten<0&&errno==EINTR)continue;
+    if(nwritten<0&&(errno==EAGAIN||errno==EWOULDBLOCK))break;
+    if(nwritten<0)return false;
+    nsent+=nwritten;
+  }
+  out.erase(0,nsent);
+  return true;
+}
+// find end of first batch in a buffer (batch is terminated by an empty line)
+// (returns position after terminating empty line or string::npos if buffer does not contain a complete batch)
+size_t batchend(string const&buf){
+  if(buf.size()>0&&buf[0]=='\n')return 1;
+  size_t pos=buf.find("\n\n");
+  return pos==string::npos?pos:pos+2;
+}
+// encode query result ('ok <count>\n' followed by one entry per variable)
+string encoderesult(map<string,Mmvm::Value>const&res){
+  string ret="ok "s+to_string(res.size())+"\n";
+  for(auto const&[name,value]:res)encodeentry(ret,name,value);
+  return ret;
+}
+// encode query as request lines (without terminating empty line)
+string encodequery(ServerQuery const&q){
+  string ret;
+  auto add=[&ret](char type,vector<string>const&args){for(auto const&arg:args)ret+=type+" "s+arg+"\n";};
+  add('v',q.names);
+  add('n',q.nss);
+  add('r',q.regexes);
+  add('V',q.exclnames);
+  add('N',q.exclnss);
+  add('R',q.exclregexes);
+  return ret;
+}
+// encode error (message must fit on one line)
+string encodeerror(string msg){
+  for(auto&c:msg)if(c=='\n')c=' ';
+  return "error "s+msg+"\n";
+}
+// decode query result
+map<string,Mmvm::Value>decoderesult(string const&resp){
+  map<string,Mmvm::Value>ret;
+  size_t eol=resp.find('\n');
+  if(eol==string::npos)throw runtime_error("invalid response from config server");
+  string status=resp.substr(0,eol);
+  if(status.compare(0,6,"error ")==0)throw runtime_error("config server: "s+status.substr(6));
+  if(status.compare(0,3,"ok ")!=0)throw runtime_error("invalid response from config server: "s+status);
+  size_t count=stoul(status.substr(3));
+  size_t pos=eol+1;
+  for(size_t i=0;i<count;++i){
+    eol=resp.find('\n',pos);
+    if(eol==string::npos)throw runtime_error("truncated response from config server");
+    char type;
+    size_t namelen,valuelen;
+    stringstream hdr(resp.substr(pos,eol-pos));
+    if(!(hdr>>type>>namelen>>valuelen)||(type!='s'&&type!='i'&&type!='l'&&type!='m'))throw runtime_error("invalid response from config server");
+    pos=eol+1;
+    if(pos+namelen+valuelen>resp.size())throw runtime_error("truncated response from config server");
+    string name=resp.substr(pos,namelen);
+    string sval=resp.substr(pos+namelen,valuelen);
+    pos+=namelen+valuelen;
+    ret[name]=decodevalue(type,sval);
+  }
+  return ret;
+}
+}
+// compare file ids
+bool ConfigServer::FileId::operator==(FileId const&other)const{
+  return dev==other.dev&&ino==other.ino&&size==other.size&&mtimens==other.mtimens;
+}
+// ctor
+ConfigServer::ConfigServer(string const&cfgpath,string const&sockpath,XConfigOptions const&opts):
+    cfgpath_(cfgpath),sockpath_(sockpath),opts_(opts),listenfd_(-1),stopfd_{-1,-1}{
+  // evaluate configuration
+  fileid_=fileid();
+  xfg_=make_unique<XConfig>(cfgpath_,opts_);
+
+  // setup self pipe used for stopping server
+  if(pipe2(stopfd_,O_CLOEXEC|O_NONBLOCK)<0)throw runtime_error("pipe2 failed: "s+strerror(errno));
+
+  // create and bind socket
+  // (a stale socket file left by a server which is no longer running is removed)
+  sockaddr_un addr=makeaddr(sockpath_);
+  listenfd_=socket(AF_UNIX,SOCK_STREAM|SOCK_CLOEXEC,0);
+  if(listenfd_<0){
+    int err=errno;
+    eclose(stopfd_[0]);eclose(stopfd_[1]);
+    throw runtime_error("socket failed: "s+strerror(err));
+  }
+  // (socket is only accessible by the owner - it is made so before the server listens so no one else can connect)
+  auto bindsock=[&]{return bind(listenfd_,reinterpret_cast<sockaddr*>(&addr),sizeof(addr))==0&&chmod(sockpath_.c_str(),S_IRUSR|S_IWUSR)==0;};
+  bool bound=bindsock();
+  if(!bound&&errno==EADDRINUSE){
+    int testfd=socket(AF_UNIX,SOCK_STREAM|SOCK_CLOEXEC,0);
+    bool alive=testfd>=0&&connect(testfd,reinterpret_cast<sockaddr*>(&addr),sizeof(addr))==0;
+    if(testfd>=0)eclose(testfd);
+    if(!alive&&unlink(sockpath_.c_str())==0)bound=bindsock();
+    else errno=EADDRINUSE;
+  }
+  if(!bound||listen(listenfd_,SOMAXCONN)<0){
+    int err=errno;
+    eclose(listenfd_);eclose(stopfd_[0]);eclose(stopfd_[1]);
+    throw runtime_error("failed listening on socket: "s+sockpath_+", error: "+strerror(err));
+  }
+}
+// dtor
+ConfigServer::~ConfigServer(){
+  eclose(listenfd_);
+  eclose(stopfd_[0]);
+  eclose(stopfd_[1]);
+  unlink(sockpath_.c_str());
+}
+// serve requests until stop() is called
+// (client sockets are non-blocking - a client which does not read its responses only stalls itself, and no new requests
+//  are read or answered for a client until its pending response has been sent)
+void ConfigServer::run(){
+  struct Client{
+    string in;                           // buffered input
+    string out;                          // responses not yet sent
+    bool eof=false;                      // no more requests are read (client closed its write side or request too large)
+  };
+  map<int,Client>clients;                // fd --> client
+  vector<pollfd>pfds;
+  while(true){
+    // wait for stop request, new connections, requests or clients ready to receive responses
+    pfds.clear();
+    pfds.push_back(pollfd{stopfd_[0],POLLIN,0});
+    pfds.push_back(pollfd{listenfd_,POLLIN,0});
+    for(auto const&[fd,client]:clients){
+      short events=(client.eof||!client.out.empty()?0:POLLIN)|(client.out.empty()?0:POLLOUT);
+      pfds.push_back(pollfd{fd,events,0});
+    }
+    int stat=poll(pfds.data(),pfds.size(),-1);
+    if(stat<0&&errno==EINTR)continue;
+    if(stat<0)throw runtime_error("poll failed: "s+strerror(errno));
+    if(pfds[0].revents)break;
+
+    // accept new connection
+    if(pfds[1].revents&POLLIN){
+      int fd=accept4(listenfd_,nullptr,nullptr,SOCK_CLOEXEC|SOCK_NONBLOCK);
+      if(fd>=0)clients[fd]=Client{};
+    }
+    // read requests, answer all complete batches and send responses
+    for(size_t i=2;i<pfds.size();++i){
+      if(!pfds[i].revents)continue;
+      int fd=pfds[i].fd;
+      Client&client=clients[fd];
+      bool ok=true;
+      if(pfds[i].events&POLLIN){
+        char rdbuf[4096];
+        ssize_t nread=read(fd,rdbuf,sizeof(rdbuf));
+        if(nread>0)client.in.append(rdbuf,nread);
+        else if(nread==0)client.eof=true;
+        else ok=errno==EINTR||errno==EAGAIN||errno==EWOULDBLOCK;
+      }
+      ok=ok&&sendbuffered(fd,client.out);
+
+      // answer next batch only when previous responses have been sent
+      // (a client sending many batches without reading responses gets one batch answered each time it reads)
+      size_t end;
+      while(ok&&client.out.empty()&&(end=batchend(client.in))!=string::npos){
+        client.out=handlebatch(client.in.substr(0,end-1));
+        client.in.erase(0,end);
+        ok=sendbuffered(fd,client.out);
+      }
+      if(ok&&client.out.empty()&&client.in.size()>maxrequestsize){
+        client.out=encodeerror("request exceeds "s+to_string(maxrequestsize)+" bytes");
+        client.in.clear();
+        client.eof=true;
+        ok=sendbuffered(fd,client.out);
+      }
+      if(!ok||(client.eof&&client.out.empty())){
+        eclose(fd);
+        clients.erase(fd);
+      }
+    }
+  }
+  for(auto const&[fd,client]:clients)eclose(fd);
+}
+// stop server
+void ConfigServer::stop()noexcept{
+  char c='x';
+  [[maybe_unused]]ssize_t stat=write(stopfd_[1],&c,1);
+}
+// answer a query
+map<string,Mmvm::Value>ConfigServer::query(ServerQuery const&q){
+  reloadifchanged();
+  return getquery(q)(xfg_->basicx().vm()->mem());
+}
+// get file id of configuration file
+ConfigServer::FileId ConfigServer::fileid()const{
+  struct stat st;
+  if(::stat(cfgpath_.c_str(),&st)<0)throw runtime_error("failed stat on file: "s+cfgpath_+", error: "+strerror(errno));
+  return FileId{st.st_dev,st.st_ino,st.st_size,static_cast<long long>(st.st_mtim.tv_sec)*1000000000LL+st.st_mtim.tv_nsec};
+}
+// re-evaluate configuration if file has changed
+// (if evaluation fails the error is reported to all callers until the file changes again)
+void ConfigServer::reloadifchanged(){
+  FileId id=fileid();
+  if(!(id==fileid_)){
+    fileid_=id;
+    try{
+      xfg_->reload(cfgpath_,opts_);
+      evalerr_.reset();
+    }
+    catch(exception const&e){
+      evalerr_=e.what();
+    }
+  }
+  if(evalerr_)throw runtime_error("failed re-evaluating configuration: "s+cfgpath_+", error: "+evalerr_.value());
+}
+// get a compiled query
+Query const&ConfigServer::getquery(ServerQuery const&q){
+  string key=encodequery(q);
+  auto it=querycache_.find(key);
+  if(it!=querycache_.end())return it->second;
+  if(querycache_.size()>=maxquerycache)querycache_.clear();
+  return querycache_.emplace(key,Query(q)).first->second;
+}
+// parse and answer a batch
+string ConfigServer::handlebatch(string const&batch){
+  try{
+    ServerQuery q;
+    size_t pos=0;
+    while(pos<batch.size()){
+      size_t eol=batch.find('\n',pos);
+      if(eol==string::npos)eol=batch.size();
+      string line=batch.substr(pos,eol-pos);
+      pos=eol+1;
+      if(line.size()<2||line[1]!=' ')return encodeerror("invalid request line: '"s+line+"'");
+      string arg=line.substr(2);
+      if(line[0]=='v')q.names.push_back(arg);
+      else if(line[0]=='n')q.nss.push_back(arg);
+      else if(line[0]=='r')q.regexes.push_back(arg);
+      else if(line[0]=='V')q.exclnames.push_back(arg);
+      else if(line[0]=='N')q.exclnss.push_back(arg);
+      else if(line[0]=='R')q.exclregexes.push_back(arg);
+      else return encodeerror("invalid request line: '"s+line+"'");
+    }
+    return encoderesult(query(q));
+  }
+  catch(exception const&e){
+    return encodeerror(e.what());
+  }
+}
+// send a batched query to a config server
+map<string,Mmvm::Value>queryserver(string const&sockpath,ServerQuery const&q){
+  // build request
+  string req=encodequery(q)+"\n";
+
+  // connect and send request
+  // (write side is shut down so server closes connection after answering)
+  sockaddr_un addr=makeaddr(sockpath);
+  int fd=socket(AF_UNIX,SOCK_STREAM|SOCK_CLOEXEC,0);
+  if(fd<0)throw runtime_error("socket failed: "s+strerror(errno));
+  if(connect(fd,reinterpret_cast<sockaddr*>(&addr),sizeof(addr))<0){
+    int err=errno;
+    eclose(fd);
+    throw runtime_error("failed connecting to config server at: "s+sockpath+", error: "+strerror(err));
+  }
+  if(!sendall(fd,req)||shutdown(fd,SHUT_WR)<0){
+    int err=errno;
+    eclose(fd);
+    throw runtime_error("failed sending request to config server at: "s+sockpath+", error: "+strerror(err));
+  }
+  // read response
+  string resp;
+  char buf[4096];
+  while(true){
+    ssize_t nread=read(fd,buf,sizeof(buf));
+    if(nread<0&&errno==EINTR)continue;
+    if(nread<0){
+      int err=errno;
+      eclose(fd);
+      throw runtime_error("failed reading response from config server at: "s+sockpath+", error: "+strerror(err));
+    }
+    if(nread==0)break;
+    resp.append(buf,nread);
+  }
+  eclose(fd);
+  return decoderesult(resp);
+}
+}
@@ -0,0 +1,77 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include "xconfig/XConfig.h"
+#include "xconfig/Mmvm.h"
+#include "xconfig/Query.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sys/types.h>
+namespace xconfig{
+
+// batched query sent to a config server
+// (result contains all variables selected by the query rules - see Query.h)
+using ServerQuery=QueryRules;
+
+// serve an evaluated configuration on a unix domain socket
+// (configuration is evaluated once and re-evaluated incrementally only when the configuration file changes)
+// (socket is only accessible by the user running the server - clients are served from one thread without blocking on a
+//  client which does not read its responses)
+// (protocol - one request per batch, a connection can send any number of batches):
+//   request:  lines '<v|n|r|V|N|R> <name|namespace|regex>\n' terminated by an empty line
+//             (upper case letters are exclude rules - a request without 'v', 'n' or 'r' lines selects all variables)
+//   response: 'ok <count>\n' followed by <count> entries '<s|i|l|m> <namelen> <valuelen>\n<name><value>'
+//             or 'error <message>\n'
+//             (a list/map value is '<size>\n' followed by elements/key-value pairs 'i<int>\n' or 's<len>\n<string>')
+class ConfigServer{
+public:
+  // ctor,assign,dtor
+  // (evaluates configuration and binds socket - throws std::runtime_error on failure)
+  ConfigServer(std::string const&cfgpath,std::string const&sockpath,XConfigOptions const&opts);
+  ConfigServer(ConfigServer const&)=delete;
+  ConfigServer(ConfigServer&&)=delete;
+  ConfigServer&operator=(ConfigServer const&)=delete;
+  ConfigServer&operator=(ConfigServer&&)=delete;
+  ~ConfigServer();
+
+  // serve requests until stop() is called
+  void run();
+
+  // stop server (async signal safe)
+  void stop()noexcept;
+
+  // answer a query
+  // (re-evaluates configuration if file has changed)
+  std::map<std::string,Mmvm::Value>query(ServerQuery const&q);
+private:
+  // identity of configuration file when it was evaluated
+  struct FileId{
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    long long mtimens;
+    bool operator==(FileId const&other)const;
+  };
+  // helper methods
+  FileId fileid()const;
+  void reloadifchanged();
+  Query const&getquery(ServerQuery const&q);
+  std::string handlebatch(std::string const&batch);
+
+  // private data
+  std::string cfgpath_;
+  std::string sockpath_;
+  XConfigOptions opts_;
+  std::unique_ptr<XConfig>xfg_;
+  FileId fileid_;
+  std::optional<std::string>evalerr_;   // error from last re-evaluation
+  int listenfd_;
+  int stopfd_[2];                       // self pipe - written by stop()
+  std::map<std::string,Query>querycache_;  // compiled queries keyed by request
+};
+// send a batched query to a config server
+// (throws std::runtime_error on failure)
+std::map<std::string,Mmvm::Value>queryserver(std::string const&sockpath,ServerQuery const&q);
+}
@@ -0,0 +1,205 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/Coproc.h"
+#include "xconfig/Environment.h"
+#include "xconfig/procutils.h"
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <cstdlib>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+using namespace std;
+namespace xconfig{
+
+// helpers
+namespace{
+// script executed by co-process
+// (reads '\0' terminated commands, executes each in a subshell with stdin from /dev/null and stdout truncating the output
+//  file given as first argument, then writes the exit status of the command followed by '\n')
+// (output never passes through the shell so it is kept byte for byte - a command calling 'exit' or 'exec' only ends its
+//  own subshell)
+string const coprocscript=
+  "__xcfg_outfile=$1;set --;"
+  "while IFS= read -r -d '' __xcfg_cmd;do "
+    "(eval \"$__xcfg_cmd\") </dev/null >\"$__xcfg_outfile\";"
+    "printf '%d\\n' \"$?\";"
+  "done";
+
+// read complete content of a file from offset 0
+bool readfile(int fd,string&out){
+  char buf[4096];
+  off_t off=0;
+  while(true){
+    ssize_t nread=pread(fd,buf,sizeof(buf),off);
+    if(nread<0&&errno==EINTR)continue;
+    if(nread<0)return false;
+    if(nread==0)return true;
+    out.append(buf,nread);
+    off+=nread;
+  }
+}
+}
+// ctor
+Coproc::Coproc(string const&shell):shell_(shell),fdread_(-1),fdwrite_(-1),fdout_(-1),cpid_(-1),envversion_(0){
+}
+// dtor
+Coproc::~Coproc(){
+  stop();
+}
+// check if co-process is running
+bool Coproc::running()const noexcept{
+  return cpid_>=0;
+}
+// stop co-process
+// (co-process terminates when it reads eof on its stdin)
+void Coproc::stop(){
+  if(!running())return;
+  eclose(fdwrite_);
+  eclose(fdread_);
+  int stat;
+  waitpid(cpid_,&stat,0);
+  eclose(fdout_);
+  cpid_=-1;
+}
+// kill co-process together with all commands it is executing
+void Coproc::kill(){
+  if(!running())return;
+  ::kill(-cpid_,SIGKILL);
+  eclose(fdwrite_);
+  eclose(fdread_);
+  int stat;
+  waitpid(cpid_,&stat,0);
+  eclose(fdout_);
+  cpid_=-1;
+}
+// start co-process
+// (output of commands is written to an unlinked temporary file which the co-process opens through '/proc' - the file
+//  disappears when the co-process is stopped, also if this process is killed)
+optional<string>Coproc::start(Environment const&env){
+  char const*tmpdir=getenv("TMPDIR");
+  string tmpl=(tmpdir&&*tmpdir?tmpdir:"/tmp")+"/xconfig-coproc-XXXXXX"s;
+  fdout_=mkostemp(tmpl.data(),O_CLOEXEC);
+  if(fdout_<0)return "failed creating output file for shell co-process: "s+tmpl+", error: "+strerror(errno);
+  unlink(tmpl.c_str());
+  string outpath="/proc/"s+to_string(getpid())+"/fd/"+to_string(fdout_);
+  vector<string>args={"bash","-c",coprocscript,"bash",outpath};
+  auto err=spawnpipchld(shell_,args,env.envp(),fdread_,fdwrite_,cpid_,true,true);
+  if(err){
+    eclose(fdout_);
+    cpid_=-1;
+    return err;
+  }
+  envversion_=env.version();
+  return nullopt;
+}
+// write a command to co-process
+// (SIGPIPE is blocked while writing so a dead co-process shows up as EPIPE instead of terminating the process)
+bool Coproc::writecmd(string const&cmd){
+  sigset_t pipeset,oldset;
+  sigemptyset(&pipeset);
+  sigaddset(&pipeset,SIGPIPE);
+  pthread_sigmask(SIG_BLOCK,&pipeset,&oldset);
+  string req=cmd+'\0';
+  char const*p=req.data();
+  size_t nleft=req.size();
+  bool ok=true;
+  while(nleft>0){
+    ssize_t nwritten=write(fdwrite_,p,nleft);
+    if(nwritten<0&&errno==EINTR)continue;
+    if(nwritten<0){
+      // consume pending SIGPIPE (if any) before restoring signal mask
+      if(errno==EPIPE){
+        timespec zero{0,0};
+        sigtimedwait(&pipeset,nullptr,&zero);
+      }
+      ok=false;
+      break;
+    }
+    p+=nwritten;
+    nleft-=nwritten;
+  }
+  pthread_sigmask(SIG_SETMASK,&oldset,nullptr);
+  return ok;
+}
+// execute a command in co-process
+pair<bool,string>Coproc::exec(string const&cmd,Environment const&env,
+                              optional<chrono::steady_clock::time_point>const&deadline,bool&timedout){
+  timedout=false;
+  if(cmd.find('\0')!=string::npos)return pair(false,"command contains '\\0' character"s);
+
+  // a command counts as one child process
+  if(!acquirechildslot(deadline)){
+    timedout=true;
+    return pair(false,"deadline passed while waiting for a free child process slot"s);
+  }
+  // (re)start co-process if needed
+  if(running()&&envversion_!=env.version())stop();
+  if(!running()){
+    auto err=start(env);
+    if(err){
+      releasechildslot();
+      return pair(false,err.value());
+    }
+  }
+  // send command
+  // (a co-process which terminated since the previous command is restarted once)
+  bool written=writecmd(cmd);
+  if(!written&&errno==EPIPE){
+    kill();
+    auto err=start(env);
+    if(err){
+      releasechildslot();
+      return pair(false,err.value());
+    }
+    written=writecmd(cmd);
+  }
+  if(!written){
+    int writeerr=errno;
+    kill();
+    releasechildslot();
+    return pair(false,"failed writing command to shell co-process: "s+strerror(writeerr));
+  }
+  // read response: <exit-status>'\n'
+  string resp;
+  char buf[4096];
+  bool eof=false;
+  while(resp.find('\n')==string::npos){
+    pollfd pfd{fdread_,POLLIN,0};
+    int stat=poll(&pfd,1,msleft(deadline));
+    if(stat<0&&errno==EINTR)continue;
+    if(stat==0){timedout=true;break;}
+    ssize_t nread=read(fdread_,buf,sizeof(buf));
+    if(nread<0&&errno==EINTR)continue;
+    if(nread<=0){eof=true;break;}
+    resp.append(buf,nread);
+  }
+  releasechildslot();
+  if(timedout){
+    kill();
+    return pair(false,"shell co-process killed after deadline passed"s);
+  }
+  if(eof){
+    kill();
+    return pair(false,"shell co-process terminated unexpectedly"s);
+  }
+  // check exit status
+  int exitcode=atoi(resp.c_str());
+  if(exitcode!=0)return pair(false,"exit status: "s+to_string(exitcode));
+
+  // get output written by command
+  string out;
+  if(!readfile(fdout_,out)){
+    int readerr=errno;
+    kill();
+    return pair(false,"failed reading output from shell co-process: "s+strerror(readerr));
+  }
+  if(out.length()&&out[out.length()-1]=='\n')out.pop_back();
+  return pair(true,out);
+}
+}
@@ -0,0 +1,49 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include <string>
+#include <optional>
+#include <chrono>
+#include <cstddef>
+namespace xconfig{
+
+// forward decl
+class Environment;
+
+// long lived shell co-process executing commands sent to it over a pipe
+// (request: command text terminated by '\0', response: exit status followed by '\n' - output of the command is written to
+//  a private temporary file shared with the co-process and is kept byte for byte, same as when forking a shell per command)
+// (each command executes in a subshell of the co-process so a command cannot change the state of the co-process)
+class Coproc{
+public:
+  // ctor,assign,dtor
+  explicit Coproc(std::string const&shell);
+  Coproc(Coproc const&)=delete;
+  Coproc(Coproc&&)=delete;
+  Coproc&operator=(Coproc const&)=delete;
+  Coproc&operator=(Coproc&&)=delete;
+  ~Coproc();
+
+  // execute a command and get output into a string
+  // (co-process is (re)started with environment 'env' if it is not running or if 'env' has been modified since it was started)
+  // (if deadline passes before command terminates, the co-process is killed and 'timedout' is set)
+  std::pair<bool,std::string>exec(std::string const&cmd,Environment const&env,
+                                  std::optional<std::chrono::steady_clock::time_point>const&deadline,bool&timedout);
+
+  // state of co-process
+  bool running()const noexcept;
+  void stop();
+private:
+  // helper methods
+  std::optional<std::string>start(Environment const&env);
+  void kill();
+  bool writecmd(std::string const&cmd);
+
+  // private data
+  std::string shell_;                  // shell program
+  int fdread_;                         // read output from co-process
+  int fdwrite_;                        // write commands to co-process
+  int fdout_;                          // unlinked file receiving output of commands
+  int cpid_;                           // pid of co-process (-1 if not running)
+  std::size_t envversion_;             // version of environment co-process was started with
+};
+}
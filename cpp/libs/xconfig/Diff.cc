@@ -0,0 +1,82 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/Diff.h"
+#include "xconfig/XConfig.h"
+#include <ostream>
+using namespace std;
+namespace xconfig{
+
+// helpers
+namespace{
+// collect differences reported by a merge pass
+template<typename C1,typename C2>
+vector<DiffEntry>collectdiff(C1&oldc,C2&newc,size_t maxchanges){
+  vector<DiffEntry>ret;
+  diff(oldc,newc,[&ret](DiffEntry::Kind kind,string const&name,Mmvm::Value const*oldval,Mmvm::Value const*newval){
+         DiffEntry d{kind,name,{},{}};
+         if(oldval)d.oldval=*oldval;
+         if(newval)d.newval=*newval;
+         ret.push_back(std::move(d));
+       },maxchanges);
+  return ret;
+}
+// write a value (strings in double quotes with '"', '\\' and newlines escaped so a value fits on one line)
+void writevalue(ostream&os,Mmvm::Value const&val){
+  visit([&os](auto&&arg){
+          using T=std::decay_t<decltype(arg)>;
+          if constexpr(std::is_same_v<T,string>){
+            os<<'"';
+            for(char c:arg){
+              if(c=='\n')os<<"\\n";
+              else if(c=='"'||c=='\\')os<<'\\'<<c;
+              else os<<c;
+            }
+            os<<'"';
+          }else{
+            os<<arg;
+          }
+        },val);
+}
+}
+// store cursor
+StoreCursor::StoreCursor(map<string,Mmvm::Value>const&mem):it_(mem.begin()),end_(mem.end()){
+}
+bool StoreCursor::done()const noexcept{return it_==end_;}
+string const&StoreCursor::name()const noexcept{return it_->first;}
+Mmvm::Value const&StoreCursor::value()const noexcept{return it_->second;}
+void StoreCursor::next(){++it_;}
+
+// get differences between two evaluated configurations
+vector<DiffEntry>diff(map<string,Mmvm::Value>const&oldmem,map<string,Mmvm::Value>const&newmem,size_t maxchanges){
+  StoreCursor oldc(oldmem);
+  StoreCursor newc(newmem);
+  return collectdiff(oldc,newc,maxchanges);
+}
+vector<DiffEntry>diff(XConfig const&oldxfg,XConfig const&newxfg,size_t maxchanges){
+  return diff(oldxfg.basicx().vm()->mem(),newxfg.basicx().vm()->mem(),maxchanges);
+}
+// get differences between two snapshot files
+vector<DiffEntry>diff(istream&oldsnapshot,istream&newsnapshot,size_t maxchanges){
+  SnapshotReader oldc(oldsnapshot);
+  SnapshotReader newc(newsnapshot);
+  return collectdiff(oldc,newc,maxchanges);
+}
+// write a difference as a single line
+void writediff(ostream&os,DiffEntry::Kind kind,string const&name,Mmvm::Value const*oldval,Mmvm::Value const*newval){
+  if(kind==DiffEntry::Kind::added){
+    os<<"+ "<<name<<"=";
+    writevalue(os,*newval);
+  }else if(kind==DiffEntry::Kind::removed){
+    os<<"- "<<name<<"=";
+    writevalue(os,*oldval);
+  }else{
+    os<<"~ "<<name<<"=";
+    writevalue(os,*oldval);
+    os<<" -> ";
+    writevalue(os,*newval);
+  }
+  os<<'\n';
+}
+void writediff(ostream&os,DiffEntry const&d){
+  writediff(os,d.kind,d.name,d.oldval?&d.oldval.value():nullptr,d.newval?&d.newval.value():nullptr);
+}
+}
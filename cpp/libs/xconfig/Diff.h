@@ -0,0 +1,76 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include "xconfig/Mmvm.h"
+#include "xconfig/Snapshot.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <optional>
+#include <limits>
+#include <iosfwd>
+namespace xconfig{
+
+// forward decl
+class XConfig;
+
+// a difference between two evaluated configurations
+// (values are typed - a string "1" and an int 1 are different values)
+struct DiffEntry{
+  enum class Kind{added=0,removed=1,changed=2};
+  Kind kind;
+  std::string name;
+  std::optional<Mmvm::Value>oldval;     // (not set if added)
+  std::optional<Mmvm::Value>newval;     // (not set if removed)
+};
+// cursor over the variables of an evaluated configuration (in name order)
+// (same interface as SnapshotReader)
+class StoreCursor{
+public:
+  explicit StoreCursor(std::map<std::string,Mmvm::Value>const&mem);
+  bool done()const noexcept;
+  std::string const&name()const noexcept;
+  Mmvm::Value const&value()const noexcept;
+  void next();
+private:
+  std::map<std::string,Mmvm::Value>::const_iterator it_;
+  std::map<std::string,Mmvm::Value>::const_iterator end_;
+};
+// compare two sorted sequences of variables in one merge pass
+// (calls 'f(kind,name,oldval,newval)' for each difference in name order - 'oldval'/'newval' is nullptr for an
+//  added/removed variable, stops after 'maxchanges' differences and returns #of differences reported)
+template<typename C1,typename C2,typename F>
+std::size_t diff(C1&oldc,C2&newc,F&&f,std::size_t maxchanges=std::numeric_limits<std::size_t>::max()){
+  std::size_t nchanges=0;
+  while(nchanges<maxchanges&&(!oldc.done()||!newc.done())){
+    int cmp=oldc.done()?1:newc.done()?-1:oldc.name().compare(newc.name());
+    if(cmp<0){
+      f(DiffEntry::Kind::removed,oldc.name(),&oldc.value(),nullptr);
+      ++nchanges;
+      oldc.next();
+    }else if(cmp>0){
+      f(DiffEntry::Kind::added,newc.name(),nullptr,&newc.value());
+      ++nchanges;
+      newc.next();
+    }else{
+      if(!(oldc.value()==newc.value())){
+        f(DiffEntry::Kind::changed,newc.name(),&oldc.value(),&newc.value());
+        ++nchanges;
+      }
+      oldc.next();
+      newc.next();
+    }
+  }
+  return nchanges;
+}
+// get differences between two evaluated configurations or two snapshot files
+// (stops after 'maxchanges' differences)
+std::vector<DiffEntry>diff(std::map<std::string,Mmvm::Value>const&oldmem,std::map<std::string,Mmvm::Value>const&newmem,
+                           std::size_t maxchanges=std::numeric_limits<std::size_t>::max());
+std::vector<DiffEntry>diff(XConfig const&oldxfg,XConfig const&newxfg,std::size_t maxchanges=std::numeric_limits<std::size_t>::max());
+std::vector<DiffEntry>diff(std::istream&oldsnapshot,std::istream&newsnapshot,std::size_t maxchanges=std::numeric_limits<std::size_t>::max());
+
+// write a difference as a single line: '+ name=value', '- name=value' or '~ name=oldvalue -> newvalue'
+// (strings are written in double quotes, lists and maps using literal syntax)
+void writediff(std::ostream&os,DiffEntry::Kind kind,std::string const&name,Mmvm::Value const*oldval,Mmvm::Value const*newval);
+void writediff(std::ostream&os,DiffEntry const&d);
+}
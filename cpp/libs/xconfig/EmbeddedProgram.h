@@ -0,0 +1,44 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include <cstddef>
+namespace xconfig{
+
+// version of embedded program format
+// (must be incremented if opcodes are renumbered or the layout of the structs below changes)
+constexpr int EMBEDDED_FORMAT_VERSION=3;
+
+// a single program element stored as static data
+// (generated by 'xconfigc' - see codegen.h)
+struct EmbeddedElement{
+  enum Kind{
+    opcode=0,                          // 'ival' is an opcode
+    intval=1,                          // 'ival' is an int value
+    strval=2                           // 'sval' points to a string value with length 'slen'
+  };
+  int kind;
+  int ival;
+  char const*sval;
+  std::size_t slen;
+};
+// code range of a statement stored as static data
+struct EmbeddedStmt{
+  std::size_t begin;
+  std::size_t end;
+};
+// line table entry stored as static data
+struct EmbeddedLine{
+  std::size_t addr;
+  int line;
+};
+// compiled and validated program stored as static data
+struct EmbeddedProgram{
+  int formatversion;                   // EMBEDDED_FORMAT_VERSION when program was generated
+  char const*name;                     // name of configuration the program was compiled from
+  std::size_t size;                    // #of elements in program
+  EmbeddedElement const*elements;      // program elements
+  std::size_t nstmts;                  // #of statements in program
+  EmbeddedStmt const*stmts;            // statements (used for incremental re-evaluation)
+  std::size_t nlines;                  // #of line table entries
+  EmbeddedLine const*lines;            // line table (source lines shown in timeline traces)
+};
+}
@@ -0,0 +1,83 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/Environment.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+using namespace std;
+namespace xconfig{
+
+// debug print function
+ostream&operator<<(ostream&os,Environment const&env){
+  for(auto const&s:env.envp())os<<s<<endl;
+  return os;
+}
+// ctors
+Environment::Environment():Environment(environ){
+}
+Environment::Environment(char const*const*envp):envpvalid_(false),version_(0){
+  for(;envp&&*envp;++envp){
+    char const*eq=strchr(*envp,'=');
+    if(!eq)continue;
+    vars_.emplace(string(*envp,eq),string(eq+1));   // first definition wins - same as getenv(...)
+  }
+}
+// get a variable
+// (returns nullptr if variable does not exist)
+string const*Environment::get(string const&name)const{
+  auto it=vars_.find(name);
+  return it==vars_.end()?nullptr:&it->second;
+}
+// set a variable
+bool Environment::set(string const&name,string const&val,bool overwrite){
+  auto[it,inserted]=vars_.try_emplace(name,val);
+  if(!inserted){
+    if(!overwrite)return false;
+    it->second=val;
+  }
+  modified_.insert(name);
+  envpvalid_=false;
+  ++version_;
+  return true;
+}
+// remove a variable
+bool Environment::unset(string const&name){
+  if(vars_.erase(name)==0)return false;
+  modified_.insert(name);
+  envpvalid_=false;
+  ++version_;
+  return true;
+}
+// #of variables
+size_t Environment::size()const noexcept{
+  return vars_.size();
+}
+// version of environment
+size_t Environment::version()const noexcept{
+  return version_;
+}
+// get environment as 'NAME=VALUE' strings
+vector<string>const&Environment::envp()const{
+  if(!envpvalid_){
+    envp_.clear();
+    envp_.reserve(vars_.size());
+    for(auto const&[name,val]:vars_)envp_.push_back(name+"="+val);
+    envpvalid_=true;
+  }
+  return envp_;
+}
+// write changes made through overlay back to process environment
+// (variables that were not modified are left alone - they may have been changed in the process since the snapshot)
+optional<string>Environment::exportenv()const{
+  for(auto const&name:modified_){
+    auto it=vars_.find(name);
+    if(it==vars_.end()){
+      if(unsetenv(name.c_str())!=0)return "failed unsetting environment variable: "s+name+", error: "+strerror(errno);
+    }else if(setenv(name.c_str(),it->second.c_str(),1)!=0){
+      return "failed setting environment variable: "s+name+" to value: '"+it->second+"', error: "+strerror(errno);
+    }
+  }
+  return nullopt;
+}
+}
@@ -0,0 +1,51 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include <string>
+#include <vector>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <iosfwd>
+namespace xconfig{
+
+// private environment overlay used while evaluating a configuration
+// (snapshot of the process environment - reading/writing the overlay never touches the process environment)
+class Environment{
+public:
+  // debug print function
+  friend std::ostream&operator<<(std::ostream&os,Environment const&env);
+
+  // ctor,assign,dtor
+  Environment();                                  // snapshot of process environment
+  explicit Environment(char const*const*envp);    // snapshot of an 'environ' style array
+  Environment(Environment const&)=default;
+  Environment(Environment&&)=default;
+  Environment&operator=(Environment const&)=default;
+  Environment&operator=(Environment&&)=default;
+  ~Environment()=default;
+
+  // get/set variables
+  // (set(...) returns false if variable exists and 'overwrite' is false)
+  std::string const*get(std::string const&name)const;
+  bool set(std::string const&name,std::string const&val,bool overwrite);
+  bool unset(std::string const&name);
+  std::size_t size()const noexcept;
+
+  // version of environment - incremented each time the environment is modified
+  std::size_t version()const noexcept;
+
+  // environment as 'NAME=VALUE' strings - passed explicitly to spawned processes
+  std::vector<std::string>const&envp()const;
+
+  // write changes made through the overlay back to process environment
+  // (only variables set or unset after the snapshot was taken are written - returns std::nullopt if no errors, else an
+  //  error string)
+  std::optional<std::string>exportenv()const;
+private:
+  std::unordered_map<std::string,std::string>vars_;  // name --> value
+  std::unordered_set<std::string>modified_;          // names of variables set or unset after snapshot was taken
+  mutable std::vector<std::string>envp_;             // cached 'NAME=VALUE' strings
+  mutable bool envpvalid_;                           // true if 'envp_' reflects 'vars_'
+  std::size_t version_;                              // modification counter
+};
+}
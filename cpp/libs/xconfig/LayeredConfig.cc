@@ -0,0 +1,82 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/LayeredConfig.h"
+#include <stdexcept>
+#include <regex>
+using namespace std;
+namespace xconfig{
+
+// ctor
+LayeredConfig::LayeredConfig(shared_ptr<XConfig const>base):base_(base),nlayers_(0){
+  if(!base_)throw runtime_error("layered configuration requires a base configuration");
+}
+// derive a configuration with a new layer of overrides
+LayeredConfig LayeredConfig::derive(map<string,Mmvm::Value>overrides)const{
+  LayeredConfig ret(*this);
+  ret.top_=make_shared<Layer const>(Layer{top_,std::move(overrides)});
+  ++ret.nlayers_;
+  return ret;
+}
+// get value of a variable
+optional<Mmvm::Value>LayeredConfig::asValue(string const&name)const{
+  for(Layer const*l=top_.get();l;l=l->below.get()){
+    auto it=l->vals.find(name);
+    if(it!=l->vals.end())return it->second;
+  }
+  return base_->asValue(name);
+}
+// get values of all variables
+map<string,Mmvm::Value>LayeredConfig::asValue()const{
+  auto ret=base_->asValue();
+  for(auto const&[name,val]:overrides())ret.insert_or_assign(name,*val);
+  return ret;
+}
+// get values of variables selected by a query
+map<string,Mmvm::Value>LayeredConfig::asValue(Query const&q)const{
+  auto ret=base_->asValue(q);
+  for(auto const&[name,val]:overrides()){
+    if(q.match(name))ret.insert_or_assign(name,*val);
+  }
+  return ret;
+}
+// get values as strings
+optional<string>LayeredConfig::operator()(string const&name)const{
+  auto val=asValue(name);
+  if(val)return Mmvm::val2string(val.value());
+  return optional<string>{};
+}
+map<string,string>LayeredConfig::operator()(Query const&q)const{
+  map<string,string>ret;
+  for(auto const&[name,val]:asValue(q))ret.emplace_hint(ret.end(),name,Mmvm::val2string(val));
+  return ret;
+}
+// getters
+shared_ptr<XConfig const>const&LayeredConfig::base()const noexcept{return base_;}
+size_t LayeredConfig::nlayers()const noexcept{return nlayers_;}
+size_t LayeredConfig::noverrides()const{return overrides().size();}
+
+// collect overrides of all layers (topmost layer wins)
+map<string,Mmvm::Value const*>LayeredConfig::overrides()const{
+  map<string,Mmvm::Value const*>ret;
+  for(Layer const*l=top_.get();l;l=l->below.get()){
+    for(auto const&[name,val]:l->vals)ret.emplace(name,&val);
+  }
+  return ret;
+}
+// parse an override on the form 'name=value'
+pair<string,Mmvm::Value>parseoverride(string const&def){
+  static regex const intre("-?[0-9]+");
+  auto pos=def.find('=');
+  if(pos==string::npos||pos==0)throw runtime_error("invalid override: '"s+def+"' - expected 'name=value'");
+  string name=def.substr(0,pos);
+  string val=def.substr(pos+1);
+  if(regex_match(val,intre)){
+    try{
+      return make_pair(name,Mmvm::Value(stoi(val)));
+    }
+    catch(out_of_range const&){
+      throw runtime_error("invalid override: '"s+def+"' - integer out of range");
+    }
+  }
+  return make_pair(name,Mmvm::Value(val));
+}
+}
@@ -0,0 +1,59 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include "xconfig/XConfig.h"
+#include "xconfig/Mmvm.h"
+#include "xconfig/Query.h"
+#include <string>
+#include <map>
+#include <memory>
+#include <optional>
+#include <utility>
+namespace xconfig{
+
+// an evaluated configuration with layers of overridden variables on top
+// (the base configuration and all layers are immutable and shared - deriving a configuration stores only the overridden
+//  variables, so the memory used by a layer is proportional to its #of overrides and copying a configuration is cheap)
+// (an override replaces the value of a variable or adds a variable - variables in the base computed from an overridden
+//  variable are not re-evaluated, use XConfig::reload(...) or an environment overlay for that)
+class LayeredConfig{
+public:
+  // ctor,assign,dtor
+  explicit LayeredConfig(std::shared_ptr<XConfig const>base);
+  LayeredConfig(LayeredConfig const&)=default;
+  LayeredConfig(LayeredConfig&&)=default;
+  LayeredConfig&operator=(LayeredConfig const&)=default;
+  LayeredConfig&operator=(LayeredConfig&&)=default;
+  ~LayeredConfig()=default;
+
+  // derive a configuration with a new layer of overrides (variable names are fully qualified)
+  LayeredConfig derive(std::map<std::string,Mmvm::Value>overrides)const;
+
+  // get values (the topmost layer overriding a variable wins)
+  std::optional<Mmvm::Value>asValue(std::string const&name)const;
+  std::map<std::string,Mmvm::Value>asValue()const;
+  std::map<std::string,Mmvm::Value>asValue(Query const&q)const;
+  std::optional<std::string>operator()(std::string const&name)const;
+  std::map<std::string,std::string>operator()(Query const&q)const;
+
+  // getters
+  std::shared_ptr<XConfig const>const&base()const noexcept;
+  std::size_t nlayers()const noexcept;          // #of layers on top of base
+  std::size_t noverrides()const;                // #of distinct variables overridden by all layers
+private:
+  // a layer of overrides (layers are never modified once created)
+  struct Layer{
+    std::shared_ptr<Layer const>below;
+    std::map<std::string,Mmvm::Value>vals;
+  };
+  // helper methods
+  std::map<std::string,Mmvm::Value const*>overrides()const;
+
+  // private data
+  std::shared_ptr<XConfig const>base_;
+  std::shared_ptr<Layer const>top_;             // topmost layer (null if no layers)
+  std::size_t nlayers_;
+};
+// parse an override on the form 'name=value'
+// (value is an int if it is an integer literal, otherwise a string)
+std::pair<std::string,Mmvm::Value>parseoverride(std::string const&def);
+}
@@ -0,0 +1,93 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/MemStats.h"
+#include <ostream>
+#include <iomanip>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <malloc.h>
+using namespace std;
+namespace xconfig{
+
+// helpers
+namespace{
+// allocations made by this thread (plain data - constant initialized so it can be used from operator new)
+thread_local AllocStats threadstats;
+
+// set when first allocation is counted
+atomic<bool>counted{false};
+}
+// add/subtract allocation counters
+AllocStats&AllocStats::operator+=(AllocStats const&other){
+  nallocs+=other.nallocs;
+  nfrees+=other.nfrees;
+  allocated+=other.allocated;
+  freed+=other.freed;
+  return*this;
+}
+AllocStats&AllocStats::operator-=(AllocStats const&other){
+  nallocs-=other.nallocs;
+  nfrees-=other.nfrees;
+  allocated-=other.allocated;
+  freed-=other.freed;
+  return*this;
+}
+// write memory statistics as a table
+void writememstats(ostream&os,MemoryStats const&stats){
+  if(stats.counted){
+    os<<left<<setw(12)<<"phase"<<right<<setw(12)<<"allocs"<<setw(12)<<"frees"<<setw(16)<<"allocated"<<setw(16)<<"freed"<<endl;
+    for(auto const&[name,a]:stats.phases){
+      os<<left<<setw(12)<<name<<right<<setw(12)<<a.nallocs<<setw(12)<<a.nfrees<<setw(16)<<a.allocated<<setw(16)<<a.freed<<endl;
+    }
+  }else{
+    os<<"(allocations not counted - operator new does not call xconfig::countedalloc)"<<endl;
+  }
+  os<<left<<setw(12)<<"structure"<<right<<setw(12)<<"elements"<<setw(16)<<"bytes"<<endl;
+  for(auto const&[name,s]:stats.structs){
+    os<<left<<setw(12)<<name<<right<<setw(12)<<s.nelems<<setw(16)<<s.bytes<<endl;
+  }
+}
+// counting allocation functions
+// (bytes are counted as the usable size of the block malloc returned)
+void*countedalloc(size_t n){
+  void*p=malloc(n?n:1);
+  if(!p)throw bad_alloc();
+  ++threadstats.nallocs;
+  threadstats.allocated+=malloc_usable_size(p);
+  if(!counted.load(memory_order_relaxed))counted.store(true,memory_order_relaxed);
+  return p;
+}
+void countedfree(void*p)noexcept{
+  if(!p)return;
+  ++threadstats.nfrees;
+  threadstats.freed+=malloc_usable_size(p);
+  free(p);
+}
+bool allocscounted()noexcept{
+  return counted.load(memory_order_relaxed);
+}
+// ctor
+AllocScope::AllocScope(AllocStats&stats,mutex*mtx):stats_(stats),mtx_(mtx),start_(threadstats){
+}
+// dtor
+AllocScope::~AllocScope(){
+  AllocStats delta=threadstats;
+  delta-=start_;
+
+  // nothing to add (always the case when allocations are not counted) - shared stats are not touched
+  if(delta.nallocs==0&&delta.nfrees==0)return;
+  if(mtx_){
+    lock_guard<mutex>lock(*mtx_);
+    stats_+=delta;
+  }else{
+    stats_+=delta;
+  }
+}
+// get heap memory owned by a string
+size_t heapbytes(string const&str)noexcept{
+  char const*p=str.data();
+  char const*obj=reinterpret_cast<char const*>(&str);
+  if(p>=obj&&p<obj+sizeof(str))return 0;
+  return str.capacity()+1;
+}
+}
@@ -0,0 +1,65 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include <string>
+#include <map>
+#include <mutex>
+#include <iosfwd>
+#include <cstddef>
+namespace xconfig{
+
+// allocations made while a phase was active
+struct AllocStats{
+  std::size_t nallocs=0;                // #of allocations
+  std::size_t nfrees=0;                 // #of deallocations
+  std::size_t allocated=0;              // bytes allocated
+  std::size_t freed=0;                  // bytes freed
+  AllocStats&operator+=(AllocStats const&other);
+  AllocStats&operator-=(AllocStats const&other);
+};
+// size of a data structure
+// (bytes is an estimate: capacity of containers, tree nodes and heap memory owned by elements)
+struct SizeStats{
+  std::size_t nelems=0;                 // #of elements
+  std::size_t bytes=0;                  // bytes used
+};
+// memory used when loading a configuration
+struct MemoryStats{
+  bool counted=false;                             // true if allocations were counted (see 'countedalloc(...)')
+  std::map<std::string,AllocStats>phases;         // scan, parse, validate, load, run, extract (only phases that were measured)
+  std::map<std::string,SizeStats>structs;         // vm structures and compile time symbol table
+};
+// write memory statistics as a table
+void writememstats(std::ostream&os,MemoryStats const&stats);
+
+// counting allocation functions
+// (allocations are only counted if the application replaces the global operator new/delete with functions calling
+//  these, e.g. 'void*operator new(std::size_t n){return xconfig::countedalloc(n);}' and
+//  'void operator delete(void*p)noexcept{xconfig::countedfree(p);}' - counters are kept per thread)
+void*countedalloc(std::size_t n);
+void countedfree(void*p)noexcept;
+bool allocscounted()noexcept;           // true if 'countedalloc(...)' has been called
+
+// count allocations made by the calling thread while the scope exists
+// (nested scopes each count all allocations made inside them)
+class AllocScope{
+public:
+  // ctor,assign,dtor
+  // (allocations are added to 'stats' when the scope ends - if 'mtx' is set it is locked while adding)
+  // (if nothing was allocated or freed in the scope, e.g. because allocations are not counted, 'mtx' is not locked)
+  explicit AllocScope(AllocStats&stats,std::mutex*mtx=nullptr);
+  AllocScope(AllocScope const&)=delete;
+  AllocScope(AllocScope&&)=delete;
+  AllocScope&operator=(AllocScope const&)=delete;
+  AllocScope&operator=(AllocScope&&)=delete;
+  ~AllocScope();
+private:
+  AllocStats&stats_;
+  std::mutex*mtx_;
+  AllocStats start_;                    // thread counters when scope started
+};
+// get heap memory owned by a string (0 if the string is stored inside the object)
+std::size_t heapbytes(std::string const&str)noexcept;
+
+// estimated bookkeeping bytes per node of a std::map/std::set (colour + parent/left/right pointers)
+constexpr std::size_t TREENODEBYTES=4*sizeof(void*);
+}
@@ -1,5 +1,8 @@
 // (C) Copyright Hans Ewetz 2018. All rights reserved.
 #include "xconfig/Mmvm.h"
+#include "xconfig/CodeQueue.h"
+#include "xconfig/ThreadPool.h"
+#include "xconfig/Tracer.h"
 #include "xconfig/MmvmError.h"
 #include "xconfig/procutils.h"
 #include "xconfig/stringutils.h"
@@ -10,66 +13,136 @@
 #include <type_traits>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <charconv>
+#include <algorithm>
+#include <iterator>
+#include <future>
+#include <limits>
 using namespace std;
 namespace xconfig{
 
 // helper functions
 namespace{
-// get environment variable
-pair<bool,string>getenvvar(string const&envvar){
-  char const*envval=std::getenv(envvar.c_str());
-  if(!envval)return pair(false,"no environment variable named '"s+envvar+"'");
-  return pair(true,string(envval));
-}
-// get environment variable
-pair<bool,string>putenv(string const&envvar,string const&envval){
-  int stat=setenv(envvar.c_str(),envval.c_str(),0);
-  if(stat!=0){
-    string errstr="failed setting environment variable: "s+envvar+" to value: '"+envval+"', error: "+strerror(errno);
-    return pair(false,errstr);
-  }
-  return pair(true,string(envval));
-}
-// execute a cmd using a shell
-pair<bool,string>execcmd(string const&cmd){
-  string file="/usr/bin/bash";                 // NOTE! hardcoded - should be taken from a variable that can be set (i.e. SHELL)
-  vector<string>args={"bash","-c"};
-  args.push_back(cmd);
-  return xconfig::execprog(file,args);
+// get operand of an instruction
+// (if 'checked' is set the type of the operand is known - it was checked by the caller or when the program was verified)
+template<typename T>
+T const&operand(Mmvm::Value const&val,bool checked){
+  return checked?*get_if<T>(&val):get<T>(val);
 }
 // convert a value to a string
 string value2string(Mmvm::Value const&val){
   string ret;
   visit([&ret](auto const&v){
-    stringstream str;
-    str<<v;
-    ret=str.str();
+    using V=std::decay_t<decltype(v)>;
+    if constexpr(std::is_same_v<V,std::string>)ret=v;
+    else if constexpr(std::is_same_v<V,int>)ret=to_string(v);
+    else ret=v.str();
+  },val);
+  return ret;
+}
+// get heap memory owned by a value
+size_t heapbytes(Mmvm::Value const&val){
+  size_t ret=0;
+  visit([&ret](auto const&v){
+    using V=std::decay_t<decltype(v)>;
+    if constexpr(std::is_same_v<V,std::string>)ret=xconfig::heapbytes(v);
+    else if constexpr(!std::is_same_v<V,int>)ret=v.heapbytes();
   },val);
   return ret;
 }
+// check if a value is a list or a map
+bool iscollection(Mmvm::Value const&val){
+  return holds_alternative<List>(val)||holds_alternative<Map>(val);
+}
+// name of type of a value (used in error messages)
+string typenameof(Mmvm::Value const&val){
+  static char const*const names[]={"int","string","list","map"};
+  return names[val.index()];
+}
+// convert a scalar value to a list element (caller must check that value is not a collection)
+List::Elem value2elem(Mmvm::Value const&val){
+  if(holds_alternative<int>(val))return get<int>(val);
+  return string_view(get<string>(val));
+}
 // add two values
-Mmvm::Value add2values(Mmvm::Value const&val1,Mmvm::Value const&val2){
+// (lists are concatenated and maps merged - a list or map cannot be added to a value of another type)
+Mmvm::Value add2values(Mmvm::Value const&val1,Mmvm::Value const&val2,size_t addr){
+  if(iscollection(val1)||iscollection(val2)){
+    if(holds_alternative<List>(val1)&&holds_alternative<List>(val2)){
+      List ret(get<List>(val1));
+      ret.append(get<List>(val2));
+      return ret;
+    }
+    if(holds_alternative<Map>(val1)&&holds_alternative<Map>(val2)){
+      Map ret(get<Map>(val1));
+      Map const&m2=get<Map>(val2);
+      for(size_t i=0;i<m2.size();++i){
+        if(!ret.insert(m2.key(i),m2.value(i))){
+          throw MmvmError(addr,MmvmError::DUPLICATE_KEY,"duplicate key '"s+string(m2.key(i))+"' when merging maps","operation 'add'");
+        }
+      }
+      return ret;
+    }
+    string errstr="cannot add "s+typenameof(val1)+" and "+typenameof(val2);
+    throw MmvmError(addr,MmvmError::TYPE_ERROR,errstr,"operation 'add' (use '@\"%{...}\"' to convert a list or map to a string)");
+  }
   Mmvm::Value ret;
   visit([&ret,&val2](auto&&v1){
     using V1=std::decay_t<decltype(v1)>;
     if constexpr(std::is_same_v<V1,std::string>){  // val1 is string
-      ret=value2string(v1)+value2string(val2);
-    }else{ // V1 == int
+      ret=v1+value2string(val2);
+    }else if constexpr(std::is_same_v<V1,int>){
       visit([&ret,&v1](auto&&v2){ 
         using V2=std::decay_t<decltype(v2)>;
         if constexpr(std::is_same_v<V2,int>){                                // val1 is int, val2 is int --> can sum them
           ret=v1+v2;
         }else{
-          ret=value2string(v1)+value2string(v2);
+          ret=to_string(v1)+value2string(v2);
         }
       },val2);
     }
   },val1);
   return ret;
 }
+// add values right to left - same result as 'add2values(vals[0],add2values(vals[1],...))'
+// (a trailing run of ints is summed, everything left of it is concatenated as strings into a single pre-sized buffer)
+Mmvm::Value concatvalues(Mmvm::Value const*vals,size_t n,size_t addr){
+  // lists and maps are added pairwise
+  if(any_of(vals,vals+n,iscollection)){
+    Mmvm::Value ret=vals[n-1];
+    for(size_t i=n-1;i>0;--i)ret=add2values(vals[i-1],ret,addr);
+    return ret;
+  }
+  size_t nsum=0;
+  int sum=0;
+  while(nsum<n&&holds_alternative<int>(vals[n-1-nsum]))sum=get<int>(vals[n-1-(nsum++)])+sum;
+  if(nsum==n)return sum;
+
+  // size buffer for strings plus max length of formatted ints
+  constexpr size_t maxintlen=std::numeric_limits<int>::digits10+2;
+  size_t nstr=n-nsum;
+  size_t len=nsum?maxintlen:0;
+  for(size_t i=0;i<nstr;++i)len+=holds_alternative<string>(vals[i])?get<string>(vals[i]).size():maxintlen;
+  string ret;
+  ret.reserve(len);
+
+  // concatenate
+  char buf[maxintlen];
+  auto appendint=[&ret,&buf](int v){
+    auto res=to_chars(buf,buf+maxintlen,v);
+    ret.append(buf,res.ptr-buf);
+  };
+  for(size_t i=0;i<nstr;++i){
+    if(holds_alternative<string>(vals[i]))ret+=get<string>(vals[i]);
+    else appendint(get<int>(vals[i]));
+  }
+  if(nsum)appendint(sum);
+  return ret;
+}
 }
 // mapping from 'inst' --> string
-map<Mmvm::Opcode,Mmvm::Instr>Mmvm::inst2info{
+map<Mmvm::Opcode,Mmvm::Instr>const Mmvm::inst2info{
   {Mmvm::Opcode::stop,{Mmvm::Opcode::stop,0,"stop",Mmvm::stop}},
   {Mmvm::Opcode::push_const,{Mmvm::Opcode::push_const,1,"push_const",Mmvm::push_const}},
   {Mmvm::Opcode::push_var,{Mmvm::Opcode::push_var,1,"push_var",Mmvm::push_var}},
@@ -82,56 +155,304 @@ map<Mmvm::Opcode,Mmvm::Instr>Mmvm::inst2info{
   {Mmvm::Opcode::set_env,{Mmvm::Opcode::set_env,1,"set_env",Mmvm::set_env}},
   {Mmvm::Opcode::push_ns,{Mmvm::Opcode::push_ns,1,"push_ns",Mmvm::push_ns}},
   {Mmvm::Opcode::pop_ns,{Mmvm::Opcode::pop_ns,0,"pop_ns",Mmvm::pop_ns}},
-  {Mmvm::Opcode::add_sym,{Mmvm::Opcode::add_sym,0,"add_sym",Mmvm::add_sym}}
+  {Mmvm::Opcode::add_sym,{Mmvm::Opcode::add_sym,1,"add_sym",Mmvm::add_sym}},
+  {Mmvm::Opcode::push_ttl,{Mmvm::Opcode::push_ttl,1,"push_ttl",Mmvm::push_ttl}},
+  {Mmvm::Opcode::pop_ttl,{Mmvm::Opcode::pop_ttl,0,"pop_ttl",Mmvm::pop_ttl}},
+  {Mmvm::Opcode::push_env_opt,{Mmvm::Opcode::push_env_opt,1,"push_env_opt",Mmvm::push_env_opt}},
+  {Mmvm::Opcode::jmp_nonempty,{Mmvm::Opcode::jmp_nonempty,1,"jmp_nonempty",Mmvm::jmp_nonempty}},
+  {Mmvm::Opcode::concat,{Mmvm::Opcode::concat,1,"concat",Mmvm::concat}},
+  {Mmvm::Opcode::make_list,{Mmvm::Opcode::make_list,1,"make_list",Mmvm::make_list}},
+  {Mmvm::Opcode::make_map,{Mmvm::Opcode::make_map,1,"make_map",Mmvm::make_map}}
 };
+vector<Mmvm::Instr const*>const Mmvm::instrtab=[]{
+  vector<Instr const*>ret(static_cast<size_t>(inst2info.rbegin()->first)+1);
+  for(auto const&[opcode,instr]:inst2info)ret.at(static_cast<size_t>(opcode))=&instr;
+  return ret;
+}();
 // ctor
-Mmvm::Mmvm():pc_(0){
+Mmvm::Mmvm():Mmvm(make_shared<Environment>()){
+}
+Mmvm::Mmvm(shared_ptr<Environment>env):
+    pc_(0),prog_(make_shared<vector<ProgElement>>()),env_(env),shellmode_(ShellMode::fork),curtrace_(nullptr),symsetfp_(0),nreplayed_(0),
+    prev_(nullptr),nextstmt_(0),curend_(0),async_(false),codeq_(nullptr){
 }
 // add an instruction to program
 size_t Mmvm::code(Opcode inst){
-  prog_.push_back(inst);
-  return prog_.size()-1;
+  mutprog().push_back(inst);
+  return prog_->size()-1;
 }
 // add an operand to program 
 size_t Mmvm::code(Value const&val){
-  prog_.push_back(val);
-  return prog_.size()-1;
+  mutprog().push_back(val);
+  return prog_->size()-1;
 }
 // add an instruction + operand to program 
 size_t Mmvm::code(Opcode inst,Value const&val){
   code(inst);
   code(val);
-  return prog_.size()-2;
+  return prog_->size()-2;
+}
+// replace a program element
+void Mmvm::patchcode(size_t addr,ProgElement const&p){
+  mutprog().at(addr)=p;
 }
 // validate program
 MmvmError Mmvm::validatecode()const{
-  size_t addr=0;
-  size_t ninstr=prog_.size();
+  return validatecode(0,prog_->size());
+}
+MmvmError Mmvm::validatecode(size_t begin,size_t end,size_t*maxdepth)const{
+  // stack depth (#of elements on value stack and on ttl stack) when reaching an address
+  struct Depth{
+    size_t nvals;
+    size_t nttls;
+    bool operator!=(Depth const&other)const{return nvals!=other.nvals||nttls!=other.nttls;}
+  };
+  size_t addr=begin;
+  size_t ninstr=end;
+  Depth depth{0,0};
+  size_t maxvals=0;
+  map<size_t,pair<size_t,Depth>>targets;   // jump target --> (address of jump, stack depth at jump target)
   while(addr<ninstr){
+    // a jump target must be an instruction reached with the same stack depth as when falling through
+    if(!targets.empty()&&targets.begin()->first<=addr){
+      auto[target,jmp]=*targets.begin();
+      if(target<addr){
+        return MmvmError(jmp.first,MmvmError::INVALID_JUMP,"jump offset "s+std::to_string(target-jmp.first)+" does not reference a following instruction");
+      }
+      if(jmp.second!=depth){
+        string errstr="jump from address "s+std::to_string(jmp.first)+" reaches instruction with stack depth "+std::to_string(jmp.second.nvals)+
+                      " - stack depth when falling through is "+std::to_string(depth.nvals);
+        return MmvmError(addr,MmvmError::STACK_MISMATCH,errstr);
+      }
+      targets.erase(targets.begin());
+    }
     // get next program element and make sure it's an instruction
-    ProgElement const&p=prog_[addr++];
+    size_t instraddr=addr;
+    ProgElement const&p=(*prog_)[addr++];
     if(!holds_alternative<Opcode>(p)){   // we must have an opcode - or error
       string errstr="expected an opcode - found value '"+val2string(get<Value>(p))+"'";
-      return MmvmError(addr-1,MmvmError::OPCODE_EXPECTED,errstr);
+      return MmvmError(instraddr,MmvmError::OPCODE_EXPECTED,errstr);
     }
     // get instruction
-    Instr const&instr=inst2info[get<Opcode>(p)];
+    auto it=inst2info.find(get<Opcode>(p));
+    if(it==inst2info.end()){
+      string errstr="invalid opcode '"s+std::to_string(static_cast<int>(get<Opcode>(p)))+"'";
+      return MmvmError(instraddr,MmvmError::INVALID_OPCODE,errstr);
+    }
+    Instr const&instr=it->second;
     if(addr+instr.npargs>ninstr){
-      string errstr="opcode '"s+instr.name+"' requires "+std::to_string(instr.npargs)+" operands - the program text only has room for "+std::to_string(ninstr-addr-1);
-      return MmvmError(addr-1,MmvmError::MISSING_OPERAND,errstr);
+      string errstr="opcode '"s+instr.name+"' requires "+std::to_string(instr.npargs)+" operands - the program text only has room for "+std::to_string(ninstr-addr);
+      return MmvmError(instraddr,MmvmError::MISSING_OPERAND,errstr);
     }
     // loop through all operands and make sure they are all values
     for(size_t i=0;i<instr.npargs;++i){
-      ProgElement const&p=prog_[addr++];
+      ProgElement const&p=(*prog_)[addr++];
       if(!holds_alternative<Value>(p)){   // we must have a value - or error
-        Instr const&instr=inst2info[get<Opcode>(p)];
-        string errstr="expected a value - found opcode '"+instr.name+"'";
+        auto it=inst2info.find(get<Opcode>(p));
+        string opname=it!=inst2info.end()?it->second.name:std::to_string(static_cast<int>(get<Opcode>(p)));
+        string errstr="expected a value - found opcode '"+opname+"'";
         return MmvmError(addr-1,MmvmError::OPCODE_EXPECTED,errstr);
       }
     }
+    // check type of operand
+    Value const*operand=instr.npargs?&get<Value>((*prog_)[instraddr+1]):nullptr;
+    auto badoperand=[&](MmvmError::error errcd,string const&expected){
+      string errstr="expected "s+expected+" as operand to '"+instr.name+"' - found value '"+val2string(*operand)+"'";
+      return MmvmError(instraddr+1,errcd,errstr);
+    };
+    auto isint=[&](int min){return holds_alternative<int>(*operand)&&get<int>(*operand)>=min;};
+    switch(instr.opcode){
+    case Opcode::push_var:
+    case Opcode::store_stack:
+    case Opcode::push_env:
+    case Opcode::set_env:
+    case Opcode::push_ns:
+    case Opcode::add_sym:
+    case Opcode::push_env_opt:
+      if(!holds_alternative<string>(*operand))return badoperand(MmvmError::EXPECT_STRING,"string");
+      break;
+    case Opcode::push_ttl:
+    case Opcode::jmp_nonempty:
+      if(!holds_alternative<int>(*operand))return badoperand(MmvmError::EXPECT_INT,"int");
+      break;
+    case Opcode::concat:
+      if(!isint(1))return badoperand(MmvmError::EXPECT_INT,"#of stack elements (>= 1)");
+      break;
+    case Opcode::make_list:
+    case Opcode::make_map:
+      if(!isint(0))return badoperand(MmvmError::EXPECT_INT,"#of stack elements (>= 0)");
+      break;
+    default:
+      break;
+    }
+    // stack effect of instruction: #of elements that must be on stack, #of elements popped and #of elements pushed
+    size_t nneed=0,npop=0,npush=0;
+    switch(instr.opcode){
+    case Opcode::push_const:
+    case Opcode::push_var:
+    case Opcode::push_env:
+    case Opcode::push_env_opt:
+      npush=1;
+      break;
+    case Opcode::store_stack:
+    case Opcode::set_env:
+      nneed=1;
+      break;
+    case Opcode::add_stack:
+      nneed=npop=2;npush=1;
+      break;
+    case Opcode::pop_stack:
+      nneed=npop=1;
+      break;
+    case Opcode::shell:
+    case Opcode::interp:
+      nneed=npop=npush=1;
+      break;
+    case Opcode::jmp_nonempty:
+      nneed=npop=1;              // (stack is popped only when falling through)
+      break;
+    case Opcode::concat:
+    case Opcode::make_list:
+      nneed=npop=get<int>(*operand);npush=1;
+      break;
+    case Opcode::make_map:
+      nneed=npop=2*static_cast<size_t>(get<int>(*operand));npush=1;
+      break;
+    default:
+      break;
+    }
+    if(depth.nvals<nneed){
+      string errstr="opcode '"s+instr.name+"' requires "+std::to_string(nneed)+" elements on stack - stack has "+std::to_string(depth.nvals);
+      return MmvmError(instraddr,MmvmError::STACK_UNDERFLOW,errstr);
+    }
+    if(instr.opcode==Opcode::pop_ttl&&depth.nttls==0){
+      return MmvmError(instraddr,MmvmError::STACK_UNDERFLOW,"opcode 'pop_ttl' without a preceding 'push_ttl'");
+    }
+    // jumps must go forward to an instruction inside the validated code
+    // (the stack is not popped when jumping)
+    if(instr.opcode==Opcode::jmp_nonempty){
+      int off=get<int>(*operand);
+      if(off<2||instraddr+off>=ninstr){
+        return MmvmError(instraddr,MmvmError::INVALID_JUMP,"jump offset "s+std::to_string(off)+" does not reference a following instruction");
+      }
+      auto[tit,inserted]=targets.emplace(instraddr+off,pair(instraddr,depth));
+      if(!inserted&&tit->second.second!=depth){
+        string errstr="jumps from addresses "s+std::to_string(tit->second.first)+" and "+std::to_string(instraddr)+" reach instruction with different stack depths";
+        return MmvmError(instraddr,MmvmError::STACK_MISMATCH,errstr);
+      }
+    }
+    depth.nvals+=npush-npop;
+    maxvals=max(maxvals,depth.nvals);
+    if(instr.opcode==Opcode::push_ttl)++depth.nttls;
+    else if(instr.opcode==Opcode::pop_ttl)--depth.nttls;
   }
+  // a jump target inside operands of the last instruction is not an instruction
+  if(!targets.empty()){
+    auto const&[target,jmp]=*targets.begin();
+    return MmvmError(jmp.first,MmvmError::INVALID_JUMP,"jump offset "s+std::to_string(target-jmp.first)+" does not reference a following instruction");
+  }
+  if(maxdepth)*maxdepth=maxvals;
   return MmvmError(addr,MmvmError::OK,"");
 }
+// validate program and mark it as verified
+MmvmError Mmvm::verifycode(){
+  size_t depth;
+  auto ret=validatecode(0,prog_->size(),&depth);
+  if(ret)maxdepth_=depth;
+  return ret;
+}
+bool Mmvm::verified()const noexcept{
+  return maxdepth_.has_value();
+}
+optional<size_t>Mmvm::maxdepth()const noexcept{
+  return maxdepth_;
+}
+// program for generating code
+// (a program shared with other vms is copied before it is modified - a modified program is no longer verified)
+vector<Mmvm::ProgElement>&Mmvm::mutprog(){
+  if(prog_.use_count()>1)prog_=make_shared<vector<ProgElement>>(*prog_);
+  maxdepth_.reset();
+  return*prog_;
+}
+// get program
+vector<Mmvm::ProgElement>const&Mmvm::prog()const noexcept{
+  return*prog_;
+}
+// replace program
+// (program is validated when it is loaded - an invalid program is never run)
+void Mmvm::loadprog(vector<ProgElement>prog){
+  prog_=make_shared<vector<ProgElement>>(std::move(prog));
+  maxdepth_.reset();
+  pc_=0;
+  if(auto err=verifycode();!err)throw err;
+}
+void Mmvm::loadprog(Mmvm const&other){
+  prog_=other.prog_;
+  maxdepth_=other.maxdepth_;
+  stmts_=other.stmts_;
+  lines_=other.lines_;
+  pc_=0;
+}
+// append blocks of code compiled into other vms
+// (program is resized once - program elements are copied, not moved, when a vector of them grows)
+// (the program stays verified if it was verified or empty and all blocks are verified - verified code leaves the stack
+//  empty at statement boundaries so blocks do not affect each other's stack depth)
+void Mmvm::appendcode(vector<CodeBlock>blocks,ThreadPool*pool){
+  optional<size_t>depth=prog_->empty()?0:maxdepth_;
+  for(auto const&block:blocks)depth=depth&&block.maxdepth?max(depth.value(),block.maxdepth.value()):optional<size_t>{};
+  auto&prog=mutprog();
+  size_t offset=prog.size();
+  size_t size=offset;
+  for(auto const&block:blocks)size+=block.code.size();
+  prog.resize(size);
+  vector<future<void>>futs;
+  for(auto&block:blocks){
+    auto moveblock=[&prog,&block,offset](){
+      std::move(block.code.begin(),block.code.end(),prog.begin()+offset);
+      vector<ProgElement>().swap(block.code);
+    };
+    for(auto const&stmt:block.stmts)stmts_.push_back(Stmt{stmt.begin+offset,stmt.end+offset});
+    for(auto const&line:block.lines)addline(line.addr+offset,line.line);
+    offset+=block.code.size();
+    if(pool)futs.push_back(pool->submit(moveblock));
+    else moveblock();
+  }
+  for(auto&fut:futs)fut.get();
+  maxdepth_=depth;
+}
+// move code out of vm
+CodeBlock Mmvm::takecode(){
+  optional<size_t>depth=maxdepth_;
+  CodeBlock ret{std::move(mutprog()),std::move(stmts_),std::move(lines_),depth};
+  mutprog().clear();
+  stmts_.clear();
+  lines_.clear();
+  pc_=0;
+  return ret;
+}
+// add a statement
+void Mmvm::addstmt(size_t begin,size_t end){
+  stmts_.push_back(Stmt{begin,end});
+}
+// get statements
+vector<Mmvm::Stmt>const&Mmvm::stmts()const noexcept{
+  return stmts_;
+}
+// add an entry to line table
+void Mmvm::addline(size_t addr,int line){
+  if(!lines_.empty()&&lines_.back().addr==addr)lines_.back().line=line;
+  else lines_.push_back(LineEntry{addr,line});
+}
+// get line table
+vector<Mmvm::LineEntry>const&Mmvm::lines()const noexcept{
+  return lines_;
+}
+// get source line of an address
+optional<int>Mmvm::line(size_t addr)const{
+  auto it=upper_bound(lines_.begin(),lines_.end(),addr,[](size_t a,LineEntry const&e){return a<e.addr;});
+  if(it==lines_.begin())return nullopt;
+  return prev(it)->line;
+}
 // check if a symbol exists
 bool Mmvm::hassym(string const&name)const{
   return mem_.count(name);
@@ -150,16 +471,108 @@ void Mmvm::addsym(string const&name,Value const&val){
 }
 // run program
 void Mmvm::run(){
-  if(prog_.size()==0)return;
-  while(true){
-    Instr const&instr=nextinstr();
-    instr.func(this);
-    if(instr.opcode==Mmvm::Opcode::stop)break;
+  begin(nullptr,false);
+  loop();
+}
+// run program replaying unchanged statements
+void Mmvm::runincremental(Mmvm const&prev){
+  begin(&prev,false);
+  loop();
+}
+// run program while it is being compiled
+void Mmvm::runpipelined(CodeQueue&queue){
+  begin(nullptr,false);
+  codeq_=&queue;
+  try{
+    loop();
   }
+  catch(...){
+    codeq_=nullptr;
+    throw;
+  }
+  codeq_=nullptr;
+}
+// start running program asynchronously
+Mmvm::RunState Mmvm::startasync(){
+  begin(nullptr,true);
+  return loop();
+}
+Mmvm::RunState Mmvm::startasync(Mmvm const&prev){
+  begin(&prev,true);
+  return loop();
+}
+// resume a suspended vm with the result of the command it waits for
+Mmvm::RunState Mmvm::resume(CmdResult const&res){
+  if(tracer_)tracecmd(pendingcmd_,pc_,pendingstart_,res.ok&&!res.timedout,false);
+  cmdresults_[pendingcmd_]=res;
+  return loop();
+}
+// command a suspended vm waits for
+string const&Mmvm::pendingcmd()const noexcept{
+  return pendingcmd_;
+}
+optional<chrono::steady_clock::time_point>Mmvm::pendingdeadline()const noexcept{
+  return pendingdeadline_;
+}
+// #of statements replayed in last run
+size_t Mmvm::nreplayed()const noexcept{
+  return nreplayed_;
+}
+// get dependency graph
+map<string,Mmvm::SymDeps>Mmvm::depgraph()const{
+  map<string,SymDeps>ret;
+  for(size_t i=0;i<stmts_.size();++i){
+    // collect dependencies from code ...
+    SymDeps deps;
+    for(size_t addr=stmts_[i].begin;addr<stmts_[i].end;++addr){
+      if(!holds_alternative<Opcode>((*prog_)[addr]))continue;
+      Opcode op=get<Opcode>((*prog_)[addr]);
+      if(op==Opcode::push_var)deps.vars.insert(get<string>(get<Value>((*prog_)[addr+1])));
+      else if(op==Opcode::push_env||op==Opcode::push_env_opt)deps.envs.insert(get<string>(get<Value>((*prog_)[addr+1])));
+    }
+    // ... and from what statement read when executed
+    if(i<traces_.size()){
+      StmtTrace const&trace=traces_[i];
+      deps.vars.insert(trace.symreads.begin(),trace.symreads.end());
+      for(auto const&[name,val]:trace.envreads)deps.envs.insert(name);
+      deps.cmds.insert(trace.cmds.begin(),trace.cmds.end());
+    }
+    // all symbols stored by statement depend on everything the statement read
+    for(size_t addr=stmts_[i].begin;addr<stmts_[i].end;++addr){
+      if(holds_alternative<Opcode>((*prog_)[addr])&&get<Opcode>((*prog_)[addr])==Opcode::store_stack){
+        ret[get<string>(get<Value>((*prog_)[addr+1]))]=deps;
+      }
+    }
+  }
+  return ret;
+}
+// set timeout for executing a single command
+void Mmvm::setcmdtimeout(chrono::milliseconds timeout){
+  cmdtimeout_=timeout;
+}
+// set deadline for executing all commands
+void Mmvm::setdeadline(chrono::steady_clock::time_point deadline){
+  deadline_=deadline;
+}
+// select how commands are executed
+void Mmvm::setshellmode(ShellMode mode){
+  shellmode_=mode;
+}
+// set tracer
+void Mmvm::settracer(shared_ptr<Tracer>tracer){
+  tracer_=tracer;
+}
+// set cache for command output
+void Mmvm::setcache(shared_ptr<CmdCache const>cache){
+  cache_=cache;
+}
+// set default ttl for cached commands
+void Mmvm::setcachettl(chrono::seconds ttl){
+  cachettl_=ttl;
 }
 // dump an instruction
 void Mmvm::dumpinst(ostream&os,Opcode i)const{
-  cout<<inst2info[i].name;
+  os<<inst2info.at(i).name;
 }
 // dump a value
 void Mmvm::dumpvalue(ostream&os,Value const&v)const{
@@ -181,12 +594,22 @@ void Mmvm::dumpprogelement(ostream&os,ProgElement const&p)const{
 // dump program in readable form
 void Mmvm::dumpprog(ostream&os)const{
   size_t no=0;
-  for(auto const&p:prog_){
+  for(auto const&p:*prog_){
     os<<setfill('0')<<setw(5)<<no++<<": ";
     dumpprogelement(os,p);
     os<<endl;
   }
 }
+// dump dependency graph
+void Mmvm::dumpdeps(ostream&os)const{
+  for(auto const&[name,deps]:depgraph()){
+    os<<name<<" <-";
+    for(auto const&var:deps.vars)os<<" var:"<<var;
+    for(auto const&env:deps.envs)os<<" env:"<<env;
+    for(auto const&cmd:deps.cmds)os<<" cmd:`"<<cmd<<"`";
+    os<<endl;
+  }
+}
 // dump stack
 void Mmvm::dumpstack(std::ostream&os)const{
   int no=0;
@@ -212,13 +635,47 @@ void Mmvm::dumpsymtab(std::ostream&os)const{
 map<string,Mmvm::Value>const&Mmvm::mem()const{
   return mem_;
 }
+// get environment overlay
+Environment const&Mmvm::env()const noexcept{
+  return *env_;
+}
 // ---------------- symbol table methods
 xconfig::Symtab const&Mmvm::symtab()const noexcept{
   return symtab_;
 }
+// memory used by vm structures
+// (a program shared with other vms is counted in full)
+map<string,SizeStats>Mmvm::memusage()const{
+  map<string,SizeStats>ret;
+  SizeStats&prog=ret["prog"];
+  prog.nelems=prog_->size();
+  prog.bytes=prog_->capacity()*sizeof(ProgElement);
+  for(auto const&p:*prog_)if(holds_alternative<Value>(p))prog.bytes+=heapbytes(get<Value>(p));
+  SizeStats&stack=ret["stack"];
+  stack.nelems=stack_.size();
+  stack.bytes=stack_.capacity()*sizeof(Value);
+  for(auto const&v:stack_)stack.bytes+=heapbytes(v);
+  SizeStats&mem=ret["mem"];
+  mem.nelems=mem_.size();
+  for(auto const&[name,v]:mem_)mem.bytes+=TREENODEBYTES+sizeof(pair<string const,Value>)+heapbytes(name)+heapbytes(v);
+  ret["symtab"]=symtab_.memusage();
+  ret["stmts"]=SizeStats{stmts_.size(),stmts_.capacity()*sizeof(Stmt)};
+  ret["lines"]=SizeStats{lines_.size(),lines_.capacity()*sizeof(LineEntry)};
+  SizeStats&traces=ret["traces"];
+  traces.nelems=traces_.size();
+  traces.bytes=traces_.capacity()*sizeof(StmtTrace);
+  for(auto const&t:traces_){
+    traces.bytes+=heapbytes(t.ns)+t.effects.capacity()*sizeof(Effect);
+    for(auto const&e:t.effects)traces.bytes+=heapbytes(e.name)+heapbytes(e.val);
+    for(auto const&r:t.symreads)traces.bytes+=TREENODEBYTES+sizeof(string)+heapbytes(r);
+    for(auto const&[name,val]:t.envreads)traces.bytes+=TREENODEBYTES+sizeof(pair<string const,optional<string>>)+heapbytes(name)+(val?heapbytes(val.value()):0);
+    for(auto const&c:t.cmds)traces.bytes+=TREENODEBYTES+sizeof(string)+heapbytes(c);
+  }
+  return ret;
+}
 // ---------------- value raletd methods
 // convert a value to a string
-string Mmvm::val2string(Mmvm::Value const&val)const{
+string Mmvm::val2string(Mmvm::Value const&val){
   return value2string(val);
 }
 // ---------------- helper methods
@@ -228,6 +685,9 @@ void Mmvm::popstack(size_t n2pop){   // pop a number of elements off the stack
 void Mmvm::pushstack(Value const&v){ // push an element on stack
   stack_.push_back(v);
 }
+void Mmvm::pushstack(Value&&v){
+  stack_.push_back(std::move(v));
+}
 Mmvm::Value const&Mmvm::stackval(size_t offset)const{
   return stack_[stack_.size()-1-offset];
 }
@@ -235,16 +695,254 @@ size_t Mmvm::incpc(){
   return pc_++;
 }
 Mmvm::Instr const&Mmvm::nextinstr(){
-  Opcode inst=get<Opcode>(prog_[incpc()]);
-  return inst2info[inst];
+  Opcode inst=get<Opcode>((*prog_)[incpc()]);
+  return inst2info.at(inst);
 }
 Mmvm::Value const&Mmvm::nextprogval(){    // get next value from program memory
-  return get<Value>(prog_[incpc()]);
+  ProgElement const&p=(*prog_)[incpc()];
+  return maxdepth_?*get_if<Value>(&p):get<Value>(p);
 }
-pair<bool,string>Mmvm::getvar(string const&name)const{
+pair<bool,string>Mmvm::getvar(string const&name){   // (only used during interpolation)
+  if(curtrace_){
+    curtrace_->symreads.insert(name);
+    curtrace_->interpvars=true;
+  }
   if(!mem_.count(name))return pair(false,"no variable named '"s+name+"'");
   return pair(true,val2string(mem_.find(name)->second));
 }
+pair<bool,string>Mmvm::getenvvar(string const&name){  // get environment variable from environment overlay
+  string const*envval=env_->get(name);
+  traceenvread(name,envval);
+  if(!envval)return pair(false,"no environment variable named '"s+name+"'");
+  return pair(true,*envval);
+}
+pair<bool,string>Mmvm::execcmd(string const&cmd){  // execute a cmd using a shell - shell gets the environment overlay
+  string file="/usr/bin/bash";                 // NOTE! hardcoded - should be taken from a variable that can be set (i.e. SHELL)
+  auto cmdstart=chrono::steady_clock::now();
+
+  // a command depends on PATH and on environment variables referenced in the command text
+  if(curtrace_){
+    curtrace_->cmds.insert(cmd);
+    traceenvread("PATH",env_->get("PATH"));
+    for(auto const&name:envrefs(cmd))traceenvread(name,env_->get(name));
+  }
+
+  // command must terminate before its timeout and before the deadline
+  optional<chrono::steady_clock::time_point>deadline=deadline_;
+  if(cmdtimeout_){
+    auto cmddeadline=chrono::steady_clock::now()+cmdtimeout_.value();
+    if(!deadline||cmddeadline<deadline.value())deadline=cmddeadline;
+  }
+  // use cached output if command output is cached and still fresh
+  // (ttl <= 0 --> command is not cached)
+  optional<chrono::seconds>ttl=ttlstack_.empty()?cachettl_:ttlstack_.back();
+  bool usecache=cache_&&ttl&&ttl.value().count()>0;
+  string cachekey;
+  if(usecache){
+    cachekey=CmdCache::makekey(cmd,*env_);
+    auto cached=cache_->get(cachekey,ttl.value());
+    if(cached){
+      if(tracer_&&!async_)tracecmd(cmd,pc_-1,cmdstart,true,true);    // (a suspended instruction may read the cache again when restarted)
+      return pair(true,cached.value());
+    }
+  }
+  // execute command either in a new shell or in the shell co-process
+  // (when running asynchronously the vm suspends and the command is executed by the caller)
+  bool timedout;
+  pair<bool,string>ret;
+  if(async_){
+    auto it=cmdresults_.find(cmd);
+    if(it==cmdresults_.end()){
+      pendingcmd_=cmd;
+      pendingdeadline_=deadline;
+      pendingstart_=cmdstart;
+      throw Suspend{};
+    }
+    ret=pair(it->second.ok,it->second.output);
+    timedout=it->second.timedout;
+  }else if(shellmode_==ShellMode::coproc){
+    if(!coproc_)coproc_=make_unique<Coproc>(file);
+    ret=coproc_->exec(cmd,*env_,deadline,timedout);
+  }else{
+    vector<string>args={"bash","-c"};
+    args.push_back(cmd);
+    ret=xconfig::execprog(file,args,env_->envp(),deadline,timedout);
+  }
+  if(tracer_&&!async_)tracecmd(cmd,pc_-1,cmdstart,ret.first&&!timedout,false);   // (asynchronous commands are traced when vm is resumed)
+  if(timedout)throw MmvmError(pc_,MmvmError::SHELL_TIMEOUT,"command timed out: '"s+cmd+"'",ret.second);
+  if(usecache&&ret.first)cache_->put(cachekey,ret.second);
+  return ret;
+}
+// prepare for executing program
+// (if 'prev' is set, statements which can be replayed from 'prev' are not executed)
+void Mmvm::begin(Mmvm const*prev,bool async){
+  traces_.assign(stmts_.size(),StmtTrace{});
+  nreplayed_=0;
+  prev_=prev;
+  async_=async;
+  nextstmt_=0;
+  curend_=0;
+  cmdresults_.clear();
+  if(maxdepth_)stack_.reserve(maxdepth_.value());
+
+  // statements in 'prev' keyed by namespace and code
+  // (identical statements are matched in program order)
+  prevstmts_.clear();
+  if(prev){
+    for(size_t i=0;i<prev->stmts_.size()&&i<prev->traces_.size();++i){
+      Stmt const&stmt=prev->stmts_[i];
+      vector<ProgElement>code(prev->prog_->begin()+stmt.begin,prev->prog_->begin()+stmt.end);
+      prevstmts_[pair(prev->traces_[i].ns,std::move(code))].push_back(i);
+    }
+  }
+}
+// execute program until it stops or suspends waiting for a command
+// (statements start and end at addresses recorded by compiler)
+Mmvm::RunState Mmvm::loop(){
+  if(prog_->size()==0&&!codeq_)return RunState::done;
+  while(true){
+    if(curtrace_&&pc_==curend_){
+      if(tracer_)tracestmt(curtrace_-traces_.data(),false,false);
+      curtrace_=nullptr;
+    }
+    if(pc_>=prog_->size()&&(!codeq_||!fetchcode()))break;
+    if(nextstmt_<stmts_.size()&&pc_==stmts_[nextstmt_].begin){
+      Stmt const&stmt=stmts_[nextstmt_];
+      StmtTrace&trace=traces_[nextstmt_++];
+      trace.ns=symtab_.currentns();
+      trace.symsetfp=symsetfp_;
+
+      // replay statement if it is unchanged and its inputs are unchanged
+      if(prev_){
+        vector<ProgElement>code(prog_->begin()+stmt.begin,prog_->begin()+stmt.end);
+        auto it=prevstmts_.find(pair(trace.ns,std::move(code)));
+        if(it!=prevstmts_.end()&&it->second.size()){
+          StmtTrace const&prevtrace=prev_->traces_[it->second.front()];
+          it->second.pop_front();
+          if(canreplay(prevtrace,*prev_)){
+            size_t symsetfp=trace.symsetfp;
+            replay(prevtrace);
+            trace=prevtrace;
+            trace.symsetfp=symsetfp;
+            pc_=stmt.end;
+            ++nreplayed_;
+            if(tracer_){
+              stmtstart_=chrono::steady_clock::now();
+              tracestmt(nextstmt_-1,true,false);
+            }
+            continue;
+          }
+        }
+      }
+      curtrace_=&trace;
+      curend_=stmt.end;
+      if(tracer_)stmtstart_=chrono::steady_clock::now();
+    }
+    // execute instruction
+    // (a suspended instruction has not modified the stack and is restarted when the vm is resumed)
+    size_t instraddr=pc_;
+    Instr const&instr=maxdepth_?*instrtab[static_cast<size_t>(*get_if<Opcode>(&(*prog_)[pc_++]))]:nextinstr();
+    try{
+      instr.func(this);
+    }
+    catch(Suspend const&){
+      pc_=instraddr;
+      return RunState::suspended;
+    }
+    catch(...){
+      if(tracer_&&curtrace_)tracestmt(curtrace_-traces_.data(),false,true);
+      if(coproc_)coproc_->stop();
+      throw;
+    }
+    if(!cmdresults_.empty())cmdresults_.clear();
+    if(instr.opcode==Mmvm::Opcode::stop)break;
+  }
+  curtrace_=nullptr;
+  prev_=nullptr;
+  prevstmts_.clear();
+
+  // an idle shell co-process is not kept alive after the program has finished
+  if(coproc_)coproc_->stop();
+  return RunState::done;
+}
+// append next block of code from queue
+// (blocks end at statement boundaries so no statement is executing when code is appended)
+bool Mmvm::fetchcode(){
+  auto block=codeq_->pop();
+  if(!block)return false;
+  optional<size_t>depth=prog_->empty()?0:maxdepth_;
+  depth=depth&&block->maxdepth?max(depth.value(),block->maxdepth.value()):optional<size_t>{};
+  mutprog().insert(prog_->end(),block->code.begin(),block->code.end());
+  maxdepth_=depth;
+  if(maxdepth_)stack_.reserve(maxdepth_.value());
+  stmts_.insert(stmts_.end(),block->stmts.begin(),block->stmts.end());
+  lines_.insert(lines_.end(),block->lines.begin(),block->lines.end());
+  traces_.resize(stmts_.size());
+  return true;
+}
+// check if a statement executed by 'prev' can be replayed
+// (everything it read must have the same value now as when it was executed)
+bool Mmvm::canreplay(StmtTrace const&prevtrace,Mmvm const&prev)const{
+  if(prevtrace.interpvars&&prevtrace.symsetfp!=symsetfp_)return false;    // interpolated names could resolve differently
+  for(auto const&name:prevtrace.symreads){
+    auto it=mem_.find(name);
+    auto previt=prev.mem_.find(name);
+    if(it==mem_.end()||previt==prev.mem_.end()||it->second!=previt->second)return false;
+  }
+  for(auto const&[name,val]:prevtrace.envreads){
+    string const*envval=env_->get(name);
+    if(static_cast<bool>(envval)!=val.has_value()||(envval&&*envval!=val.value()))return false;
+  }
+  return true;
+}
+// replay effects of a statement
+void Mmvm::replay(StmtTrace const&prevtrace){
+  for(auto const&effect:prevtrace.effects){
+    if(effect.kind==Effect::addsym)addsymtab(effect.name);
+    else if(effect.kind==Effect::store)mem_[effect.name]=effect.val;
+    else env_->set(effect.name,val2string(effect.val),false);
+  }
+}
+// add a symbol to runtime symbol table
+void Mmvm::addsymtab(string const&name){
+  string fqname=symtab_.addsym(name);
+  symsetfp_=(symsetfp_^hash<string>{}(fqname))*1099511628211ULL;
+  if(curtrace_)curtrace_->effects.push_back(Effect{Effect::addsym,name,Value{}});
+}
+// record that current statement read an environment variable
+// (only the first read is recorded - later reads may see values set by the statement itself)
+void Mmvm::traceenvread(string const&name,string const*val){
+  if(!curtrace_)return;
+  curtrace_->envreads.emplace(name,val?optional<string>(*val):nullopt);
+}
+// record execution of a statement in timeline trace
+// (event is named after the variables the statement stored)
+void Mmvm::tracestmt(size_t stmtno,bool replayed,bool failed){
+  StmtTrace const&trace=traces_[stmtno];
+  string name;
+  for(auto const&effect:trace.effects){
+    if(effect.kind==Effect::store)name+=(name.empty()?"":",")+effect.name;
+  }
+  auto line=this->line(stmts_[stmtno].begin);
+  if(name.empty())name=line?"line "s+std::to_string(line.value()):"statement "s+std::to_string(stmtno);
+  Tracer::Args args;
+  if(line)args.emplace_back("line",std::to_string(line.value()));
+  if(!trace.ns.empty())args.emplace_back("namespace",trace.ns);
+  if(replayed)args.emplace_back("replayed","true");
+  if(failed)args.emplace_back("failed","true");
+  tracer_->complete(name,"statement",stmtstart_,chrono::steady_clock::now(),args);
+}
+// record execution of a command in timeline trace
+// ('addr' is the address of the instruction executing the command)
+void Mmvm::tracecmd(string const&cmd,size_t addr,chrono::steady_clock::time_point start,bool ok,bool cached){
+  Tracer::Args args{{"cmd",cmd}};
+  auto line=this->line(addr);
+  if(line)args.emplace_back("line",std::to_string(line.value()));
+  args.emplace_back("status",ok?"ok":"failed");
+  if(cached)args.emplace_back("cached","true");
+  string name=cmd.size()>60?cmd.substr(0,57)+"...":cmd;
+  tracer_->complete(name,"command",start,chrono::steady_clock::now(),args);
+}
 // ---------------- instructions
 void Mmvm::stop(Mmvm*vm){   // stop - dummy instruction
   vm->incpc();
@@ -254,29 +952,88 @@ void Mmvm::push_const(Mmvm*vm){  // push value below 'pc'
   vm->pushstack(val);
 }
 void Mmvm::push_var(Mmvm*vm){  // push value of symbol having name located below pc
-  string const&symname=get<string>(vm->nextprogval());
+  string const&symname=operand<string>(vm->nextprogval(),vm->verified());
   if(!vm->hassym(symname))throw MmvmError(vm->pc_,MmvmError::NO_SYM,"no symbol named: "s+symname,"operation 'pushs'");
+  if(vm->curtrace_)vm->curtrace_->symreads.insert(symname);
   vm->pushstack(vm->mem_[symname]);
 }
 void Mmvm::store_stack(Mmvm*vm){  // store top of stack --> symbol (symbol name is after instruction)
-  string const&symname=get<string>(vm->nextprogval());
+  string const&symname=operand<string>(vm->nextprogval(),vm->verified());
   Value const&val=vm->stackval();
   vm->mem_[symname]=val;
+  if(vm->curtrace_)vm->curtrace_->effects.push_back(Effect{Effect::store,symname,val});
 }
 void Mmvm::add_stack(Mmvm*vm){  // add two top elements on stack as strings and push result on stack
-  Value res=add2values(vm->stackval(1),vm->stackval(0));
+  Value res=add2values(vm->stackval(1),vm->stackval(0),vm->pc_);
   vm->popstack(2);
   vm->pushstack(res);
 }
+void Mmvm::concat(Mmvm*vm){  // add #of top elements on stack (as a chain of 'add_stack') and push result on stack
+  Value const&nval=vm->nextprogval();
+  if(!vm->verified()&&(!holds_alternative<int>(nval)||get<int>(nval)<1||static_cast<size_t>(get<int>(nval))>vm->stack_.size())){
+    string errstr="invalid operand found";
+    string detail="expected #of stack elements as operand to 'concat' - found value '"+vm->val2string(nval)+"'";
+    throw MmvmError(vm->pc_,MmvmError::EXPECT_INT,errstr,detail);
+  }
+  size_t n=operand<int>(nval,true);
+  Value res=concatvalues(vm->stack_.data()+vm->stack_.size()-n,n,vm->pc_);
+  vm->popstack(n);
+  vm->pushstack(std::move(res));
+}
+void Mmvm::make_list(Mmvm*vm){  // pop #of elements stored below opcode and push them as a list
+  Value const&nval=vm->nextprogval();
+  if(!vm->verified()&&(!holds_alternative<int>(nval)||get<int>(nval)<0||static_cast<size_t>(get<int>(nval))>vm->stack_.size())){
+    string errstr="invalid operand found";
+    string detail="expected #of stack elements as operand to 'make_list' - found value '"+vm->val2string(nval)+"'";
+    throw MmvmError(vm->pc_,MmvmError::EXPECT_INT,errstr,detail);
+  }
+  size_t n=operand<int>(nval,true);
+  Value const*vals=vm->stack_.data()+vm->stack_.size()-n;
+  size_t nchars=0;
+  for(size_t i=0;i<n;++i){
+    if(iscollection(vals[i]))throw MmvmError(vm->pc_,MmvmError::TYPE_ERROR,"list element cannot be a "s+typenameof(vals[i]),"operation 'make_list'");
+    if(holds_alternative<string>(vals[i]))nchars+=get<string>(vals[i]).size();
+  }
+  List res;
+  res.reserve(n,nchars);
+  for(size_t i=0;i<n;++i)res.push_back(value2elem(vals[i]));
+  vm->popstack(n);
+  vm->pushstack(std::move(res));
+}
+void Mmvm::make_map(Mmvm*vm){  // pop #of key/value pairs stored below opcode and push them as a map
+  Value const&nval=vm->nextprogval();
+  if(!vm->verified()&&(!holds_alternative<int>(nval)||get<int>(nval)<0||2*static_cast<size_t>(get<int>(nval))>vm->stack_.size())){
+    string errstr="invalid operand found";
+    string detail="expected #of stack element pairs as operand to 'make_map' - found value '"+vm->val2string(nval)+"'";
+    throw MmvmError(vm->pc_,MmvmError::EXPECT_INT,errstr,detail);
+  }
+  size_t n=operand<int>(nval,true);
+  Value const*vals=vm->stack_.data()+vm->stack_.size()-2*n;
+  size_t nchars=0;
+  for(size_t i=0;i<2*n;++i){
+    if(iscollection(vals[i]))throw MmvmError(vm->pc_,MmvmError::TYPE_ERROR,"map key or value cannot be a "s+typenameof(vals[i]),"operation 'make_map'");
+    if(i%2==0)nchars+=holds_alternative<string>(vals[i])?get<string>(vals[i]).size():0;
+  }
+  Map res;
+  res.reserve(n,nchars);
+  for(size_t i=0;i<n;++i){
+    string key=value2string(vals[2*i]);
+    if(!res.insert(key,value2elem(vals[2*i+1]))){
+      throw MmvmError(vm->pc_,MmvmError::DUPLICATE_KEY,"duplicate key '"s+key+"' in map","operation 'make_map'");
+    }
+  }
+  vm->popstack(n*2);
+  vm->pushstack(std::move(res));
+}
 void Mmvm::push_env(Mmvm*vm){  // push value of environment variable onto stack (name of environment variabel stored below opcode)
   Value const&val=vm->nextprogval();
-  if(!holds_alternative<string>(val)){   // we must have a string - or error
+  if(!vm->verified()&&!holds_alternative<string>(val)){   // we must have a string - or error
     string errstr="invalid operand found";
     string detail="expected string as operand to 'push_env' - found value '"+vm->val2string(val)+"'";
     throw MmvmError(vm->pc_,MmvmError::EXPECT_STRING,errstr,detail);
   }
   // get environment variable
-  auto envres=getenvvar(get<string>(val));
+  auto envres=vm->getenvvar(operand<string>(val,true));
   if(!envres.first)throw MmvmError(vm->pc_,MmvmError::NOSUCH_ENVVAR,envres.second,"operation 'pushe'");
   vm->pushstack(envres.second);
 }
@@ -285,24 +1042,29 @@ void Mmvm::pop_stack(Mmvm*vm){  // pop_stack
 }
 void Mmvm::shell(Mmvm*vm){  // execute program, store output on stack
   string execstr=vm->val2string(vm->stackval());
-  auto[err,res]=execcmd(execstr);
+  auto[err,res]=vm->execcmd(execstr);
   if(!err)throw MmvmError(vm->pc_,MmvmError::SHELL_ERROR,res,"operation 'shell'");
   vm->popstack(1);
-  vm->pushstack(res);
+  vm->pushstack(std::move(res));
 }
 void Mmvm::interp(Mmvm*vm){  // interpolate string on stack and push result back in stack
-  string str=vm->val2string(vm->stackval());
+  // a string without characters to interpolate is left on the stack as is
+  Value const&val=vm->stackval();
+  if(holds_alternative<string>(val)&&!needsinterpolation(get<string>(val)))return;
+  string str=vm->val2string(val);
+  auto fgetenv=[vm](string const&name){return vm->getenvvar(name);};
   auto fgetvar=[vm](string const&name){return vm->getvar(name);};
-  auto res=xconfig::interpolate(str,getenvvar,fgetvar,execcmd,vm->symtab());
+  auto fexeccmd=[vm](string const&cmd){return vm->execcmd(cmd);};
+  auto res=xconfig::interpolate(std::move(str),fgetenv,fgetvar,fexeccmd,vm->symtab());
   if(!res.first){
     throw MmvmError(vm->pc_,MmvmError::INTERP_ERROR,"string interpolation error",res.second);
   }
   vm->popstack(1);
-  vm->pushstack(res.second);
+  vm->pushstack(std::move(res.second));
 }
 void Mmvm::set_env(Mmvm*vm){  // store top of stack in environment variable following this opcode
   Value const&envvar=vm->nextprogval();
-  if(!holds_alternative<string>(envvar)){   // we must have a string - or error
+  if(!vm->verified()&&!holds_alternative<string>(envvar)){   // we must have a string - or error
     string errstr="invalid operand found";
     string detail="expected string as operand to 'set_env' - found value '"+vm->val2string(envvar)+"'";
     throw MmvmError(vm->pc_,MmvmError::EXPECT_STRING,errstr,detail);
@@ -310,29 +1072,76 @@ void Mmvm::set_env(Mmvm*vm){  // store top of stack in environment variable foll
   // get top of stack
   auto const&envval=vm->stackval();
 
-  // set environment variable
-  auto envres=putenv(get<string>(envvar),vm->val2string(envval));
-  if(!envres.first)throw MmvmError(vm->pc_,MmvmError::NOSUCH_ENVVAR,envres.second,"operation 'set_env'");
+  // set environment variable in environment overlay
+  // (same as 'setenv(..., 0)' - an existing variable is not overwritten)
+  string const&name=operand<string>(envvar,true);
+  vm->env_->set(name,vm->val2string(envval),false);
+  if(vm->curtrace_)vm->curtrace_->effects.push_back(Effect{Effect::setenv,name,envval});
 }
 void Mmvm::push_ns(Mmvm*vm){
   Value const&ns=vm->nextprogval();
-  if(!holds_alternative<string>(ns)){   // we must have a string - or error
+  if(!vm->verified()&&!holds_alternative<string>(ns)){   // we must have a string - or error
     string errstr="invalid operand found";
     string detail="expected string as operand to 'push_ns' - found value '"+vm->val2string(ns)+"'";
     throw MmvmError(vm->pc_,MmvmError::EXPECT_STRING,errstr,detail);
   }
-  vm->symtab_.pushns(get<string>(ns));
+  vm->symtab_.pushns(operand<string>(ns,true));
 }
 void Mmvm::pop_ns(Mmvm*vm){
   vm->symtab_.popns();
 }
 void Mmvm::add_sym(Mmvm*vm){
   Value const&sym=vm->nextprogval();
-  if(!holds_alternative<string>(sym)){   // we must have a string - or error
+  if(!vm->verified()&&!holds_alternative<string>(sym)){   // we must have a string - or error
     string errstr="invalid operand found";
     string detail="expected string as operand to 'add_sym' - found value '"+vm->val2string(sym)+"'";
     throw MmvmError(vm->pc_,MmvmError::EXPECT_STRING,errstr,detail);
   }
-  vm->symtab_.addsym(get<string>(sym));
+  vm->addsymtab(operand<string>(sym,true));
+}
+void Mmvm::push_ttl(Mmvm*vm){
+  Value const&ttl=vm->nextprogval();
+  if(!vm->verified()&&!holds_alternative<int>(ttl)){   // we must have an int - or error
+    string errstr="invalid operand found";
+    string detail="expected int as operand to 'push_ttl' - found value '"+vm->val2string(ttl)+"'";
+    throw MmvmError(vm->pc_,MmvmError::EXPECT_INT,errstr,detail);
+  }
+  vm->ttlstack_.push_back(chrono::seconds(operand<int>(ttl,true)));
+}
+void Mmvm::pop_ttl(Mmvm*vm){
+  vm->ttlstack_.pop_back();
+}
+void Mmvm::push_env_opt(Mmvm*vm){  // push value of environment variable or an empty string if it is not set
+  Value const&val=vm->nextprogval();
+  if(!vm->verified()&&!holds_alternative<string>(val)){   // we must have a string - or error
+    string errstr="invalid operand found";
+    string detail="expected string as operand to 'push_env_opt' - found value '"+vm->val2string(val)+"'";
+    throw MmvmError(vm->pc_,MmvmError::EXPECT_STRING,errstr,detail);
+  }
+  auto envres=vm->getenvvar(operand<string>(val,true));
+  vm->pushstack(envres.first?envres.second:""s);
+}
+void Mmvm::jmp_nonempty(Mmvm*vm){  // keep top of stack and jump forward if it is not an empty string/list/map, else pop it
+  size_t instraddr=vm->pc_-1;
+  Value const&offset=vm->nextprogval();
+  if(!vm->verified()&&!holds_alternative<int>(offset)){   // we must have an int - or error
+    string errstr="invalid operand found";
+    string detail="expected int as operand to 'jmp_nonempty' - found value '"+vm->val2string(offset)+"'";
+    throw MmvmError(vm->pc_,MmvmError::EXPECT_INT,errstr,detail);
+  }
+  int off=operand<int>(offset,true);
+  if(!vm->verified()&&(off<=0||instraddr+off>vm->prog_->size())){   // jump must stay inside the program
+    throw MmvmError(instraddr,MmvmError::INVALID_JUMP,"jump offset "s+std::to_string(off)+" does not reference a following instruction");
+  }
+  Value const&top=vm->stackval();
+  bool empty=visit([](auto const&v){
+    if constexpr(std::is_same_v<std::decay_t<decltype(v)>,int>)return false;
+    else return v.empty();
+  },top);
+  if(empty){
+    vm->popstack();
+    return;
+  }
+  vm->pc_=instraddr+off;
 }
 }
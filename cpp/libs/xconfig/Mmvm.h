@@ -2,12 +2,22 @@
 #pragma once
 #include "xconfig/MmvmError.h"
 #include "xconfig/Symtab.h"
+#include "xconfig/Environment.h"
+#include "xconfig/Coproc.h"
+#include "xconfig/CmdCache.h"
+#include "xconfig/Collections.h"
+#include "xconfig/MemStats.h"
 #include <string>
 #include <iosfwd>
 #include <vector>
 #include <map>
+#include <set>
+#include <deque>
 #include <variant>
 #include <functional>
+#include <memory>
+#include <chrono>
+#include <optional>
 
 // NOTE! TODO
 /*
@@ -16,6 +26,11 @@
  * (2) code a simple debugger that displays all relevant data structures (stack, memory and program)
  */
 namespace xconfig{
+// forward decl
+class CodeQueue;
+struct CodeBlock;
+class ThreadPool;
+class Tracer;
 
 // vm class
 class Mmvm{
@@ -34,22 +49,91 @@ public:
     set_env=9,                       // store top of stack into environment variable following this opcode
     push_ns=10,                      // enter new namespace - ns specified as next memory locatino
     pop_ns=11,                       // enter new namespace
-    add_sym=12                       // add symbol in current namespace
+    add_sym=12,                      // add symbol in current namespace
+    push_ttl=13,                     // cache output of commands for #of seconds stored below opcode (until matching pop_ttl)
+    pop_ttl=14,                      // restore previous cache ttl
+    push_env_opt=15,                 // push value of environment variable onto stack - empty string if not set (name stored below opcode)
+    jmp_nonempty=16,                 // jump forward #of elements stored below opcode if top of stack is not an empty string/list/map, else pop stack
+    concat=17,                       // add #of top elements on stack stored below opcode (right to left as add_stack) and push result on stack
+    make_list=18,                    // pop #of elements stored below opcode and push a list of them (first element pushed first)
+    make_map=19                      // pop #of key/value pairs stored below opcode and push a map of them (key pushed before value)
+  };
+  // how commands are executed
+  enum class ShellMode{
+    fork=0,                          // fork/exec a new shell for each command
+    coproc=1                         // send commands to one long lived shell co-process
   };
   // typedefs
-  using Value=std::variant<int,std::string>;           // data stored in symbol table, on stack or as operand in program
+  using Value=std::variant<int,std::string,List,Map>;  // data stored in symbol table, on stack or as operand in program
   using ProgElement=std::variant<Opcode,Value>;        // program consists of opcodes and values
 
+  // code range of a top level statement
+  // (statements are the unit of incremental re-evaluation)
+  struct Stmt{
+    std::size_t begin;               // address of first instruction in statement
+    std::size_t end;                 // address after last instruction in statement
+  };
+  // source line where code starting at an address was compiled from
+  // (debug line table - an address belongs to the entry with the highest address not above it)
+  struct LineEntry{
+    std::size_t addr;                // address of first program element compiled from line
+    int line;                        // source line
+  };
+  // what a symbol depends on
+  struct SymDeps{
+    std::set<std::string>vars;       // variables (fully qualified names)
+    std::set<std::string>envs;       // environment variables
+    std::set<std::string>cmds;       // commands
+  };
+
   // ctor
   Mmvm();
+  explicit Mmvm(std::shared_ptr<Environment>env);
 
   // generate code - returns address where code is located
   std::size_t code(Opcode);
   std::size_t code(Value const&val);
   std::size_t code(Opcode inst,Value const&val);
 
-  // validate program
+  // replace an already generated program element (used for patching jumps)
+  void patchcode(std::size_t addr,ProgElement const&p);
+
+  // validate program / validate code in address range [begin,end)
+  // (checks opcodes, operand types and jumps and computes the stack effect of each instruction - the stack must be empty at
+  //  'begin' and may not underflow, paths reaching an instruction must agree on stack depth - 'maxdepth' is set to the max
+  //  stack depth reached by the code)
   MmvmError validatecode()const;
+  MmvmError validatecode(std::size_t begin,std::size_t end,std::size_t*maxdepth=nullptr)const;
+
+  // validate program and mark it as verified if it is valid
+  // (a verified program runs without operand type and stack checks on a stack reserved up front - modifying the program
+  //  clears the mark)
+  MmvmError verifycode();
+  bool verified()const noexcept;
+  std::optional<std::size_t>maxdepth()const noexcept;
+
+  // get program / replace program
+  // (a program given as code is validated and verified when it is loaded - an invalid program throws an MmvmError)
+  // (loading the program of another vm also loads its statements and line table - the program is not copied but shared
+  //  between the vms, vms sharing a program may run concurrently)
+  std::vector<ProgElement>const&prog()const noexcept;
+  void loadprog(std::vector<ProgElement>prog);
+  void loadprog(Mmvm const&other);
+
+  // append blocks of code compiled into other vms / move code out of vm
+  // (addresses of statements and line table entries in an appended block are relative to the start of the block - blocks
+  //  are moved into place on 'pool' if set, taking code out of a vm leaves the vm with an empty program)
+  void appendcode(std::vector<CodeBlock>blocks,ThreadPool*pool=nullptr);
+  CodeBlock takecode();
+
+  // statements (recorded by compiler)
+  void addstmt(std::size_t begin,std::size_t end);
+  std::vector<Stmt>const&stmts()const noexcept;
+
+  // debug line table (recorded by compiler)
+  void addline(std::size_t addr,int line);
+  std::vector<LineEntry>const&lines()const noexcept;
+  std::optional<int>line(std::size_t addr)const;
 
   // mem methods
   bool hassym(std::string const&name)const;
@@ -59,6 +143,51 @@ public:
   // execution methods
   void run();
 
+  // run program replaying statements whose code and inputs are unchanged since they were executed by 'prev'
+  // (a replayed statement is not executed - its effects on symbols and environment are copied from 'prev')
+  void runincremental(Mmvm const&prev);
+  std::size_t nreplayed()const noexcept;
+
+  // run program while it is being compiled on another thread
+  // (program must be empty - code is taken from 'queue' each time execution reaches the end of the code received so far)
+  // (returns without error if the queue is closed before the program stops)
+  void runpipelined(CodeQueue&queue);
+
+  // run program asynchronously
+  // (instead of executing a command the vm suspends - the caller executes 'pendingcmd()' and resumes the vm with the result)
+  // (commands are always executed by the caller - the shell mode is not used)
+  struct CmdResult{
+    bool ok;                            // true if command succeeded
+    std::string output;                 // output of command or error message
+    bool timedout;                      // true if command was killed because 'pendingdeadline()' passed
+  };
+  enum class RunState{done=0,suspended=1};
+  RunState startasync();
+  RunState startasync(Mmvm const&prev);
+  RunState resume(CmdResult const&res);
+  std::string const&pendingcmd()const noexcept;
+  std::optional<std::chrono::steady_clock::time_point>pendingdeadline()const noexcept;
+
+  // dependency graph: symbol --> variables, environment variables and commands it depends on
+  // (derived from code and from what each statement read when it was last executed)
+  std::map<std::string,SymDeps>depgraph()const;
+
+  // limits on executing commands
+  // (a command is killed when its timeout or the deadline passes)
+  void setcmdtimeout(std::chrono::milliseconds timeout);
+  void setdeadline(std::chrono::steady_clock::time_point deadline);
+
+  // select how commands are executed
+  void setshellmode(ShellMode mode);
+
+  // record executed statements and commands in a timeline trace
+  void settracer(std::shared_ptr<Tracer>tracer);
+
+  // cache for command output and default ttl for cached commands
+  // (without a default ttl only commands inside 'cache <ttl> <expr>' are cached)
+  void setcache(std::shared_ptr<CmdCache const>cache);
+  void setcachettl(std::chrono::seconds ttl);
+
   // dump various pieces of information
   void dumpinst(std::ostream&os,Opcode i)const;
   void dumpvalue(std::ostream&os,Value const&v)const;
@@ -69,6 +198,7 @@ public:
   void dumpstack(std::ostream&os)const;
   void dumpmem(std::ostream&os)const;
   void dumpsymtab(std::ostream&os)const;
+  void dumpdeps(std::ostream&os)const;
 
   // symbol table methods
   // (used during string interpolation)
@@ -77,33 +207,102 @@ public:
   // get memory
   std::map<std::string,Value>const&mem()const;
 
+  // memory used by vm structures (prog, stack, mem, symtab, stmts, lines, traces)
+  std::map<std::string,SizeStats>memusage()const;
+
+  // get environment overlay
+  Environment const&env()const noexcept;
+
   // value related methods
-  std::string val2string(Value const&val)const;
+  // (a list is converted to its elements separated by blanks, a map to blank separated 'key=value' entries)
+  static std::string val2string(Value const&val);
 private:
   // vm state
   std::size_t pc_;                      // program counter
-  std::vector<ProgElement>prog_;        // program (opcodes and operands)
+  std::shared_ptr<std::vector<ProgElement>>prog_;  // program (opcodes and operands - may be shared with other vms)
   std::vector<Value>stack_;             // stack
+  std::optional<std::size_t>maxdepth_;  // max stack depth of program (only set if program has been verified)
   std::map<std::string,Value>mem_;      // memory (addressed by symbol name)
   xconfig::Symtab symtab_;                // runtime symbol table - used during string interpolation
+  std::shared_ptr<Environment>env_;     // environment overlay - used instead of process environment
+  std::optional<std::chrono::milliseconds>cmdtimeout_;              // max time a single command may execute
+  std::optional<std::chrono::steady_clock::time_point>deadline_;    // all commands must have terminated at this time
+  ShellMode shellmode_;                 // how commands are executed
+  std::unique_ptr<Coproc>coproc_;       // shell co-process (only used if shellmode_ == coproc - stopped when program ends)
+  std::shared_ptr<CmdCache const>cache_;                 // cache for command output (null if not used)
+  std::optional<std::chrono::seconds>cachettl_;          // default ttl for cached commands
+  std::vector<std::chrono::seconds>ttlstack_;            // ttl set with 'push_ttl' instructions
+
+  // effect of a statement on symbols and environment
+  struct Effect{
+    enum Kind{addsym=0,store=1,setenv=2};
+    Kind kind;
+    std::string name;                   // symbol name or environment variable
+    Value val;                          // stored value (not used for 'addsym')
+  };
+  // what a statement read and did when it was executed
+  struct StmtTrace{
+    std::string ns;                                        // namespace statement executed in
+    std::vector<Effect>effects;                            // effects in execution order
+    std::set<std::string>symreads;                         // variables read (fully qualified)
+    std::map<std::string,std::optional<std::string>>envreads;   // environment variables read (and their values)
+    std::set<std::string>cmds;                             // commands executed
+    bool interpvars=false;                                 // variables were looked up during interpolation
+    std::size_t symsetfp=0;                                // fingerprint of symbols defined before statement
+  };
+  std::vector<Stmt>stmts_;              // statements in program
+  std::vector<LineEntry>lines_;         // debug line table
+  std::shared_ptr<Tracer>tracer_;       // timeline trace (null if not traced)
+  std::chrono::steady_clock::time_point stmtstart_;      // when executing statement started
+  std::chrono::steady_clock::time_point pendingstart_;   // when vm suspended waiting for a command
+  std::vector<StmtTrace>traces_;        // one trace per statement (filled when program runs)
+  StmtTrace*curtrace_;                  // trace of executing statement (null if not inside a statement)
+  std::size_t symsetfp_;                // fingerprint of symbols defined so far (interpolation resolves names against these)
+  std::size_t nreplayed_;               // #of statements replayed in last run
+
+  // execution state (kept between suspending and resuming the vm)
+  struct Suspend{};                     // thrown by 'execcmd' when vm must wait for a command
+  Mmvm const*prev_;                     // vm statements are replayed from (null if none)
+  std::map<std::pair<std::string,std::vector<ProgElement>>,std::deque<std::size_t>>prevstmts_;  // (ns,code) --> statements in prev
+  std::size_t nextstmt_;                // next statement to start
+  std::size_t curend_;                  // end of executing statement
+  bool async_;                          // vm suspends instead of executing commands
+  std::map<std::string,CmdResult>cmdresults_;     // results of commands executed by the caller for current instruction
+  std::string pendingcmd_;              // command vm waits for
+  std::optional<std::chrono::steady_clock::time_point>pendingdeadline_;  // deadline for command vm waits for
+  CodeQueue*codeq_;                     // queue code is taken from while program is being compiled (null if not pipelined)
 
   // opcode --> instruction map
   struct Instr{
     Opcode opcode;                      // opcode
     std::size_t npargs;                 // #of operands for opcode
     std::string name;                   // name of opcode
-    std::function<void(Mmvm*)>func;     // function executing the opcode
+    void(*func)(Mmvm*);                 // function executing the opcode
   };
-  static std::map<Opcode,Instr>inst2info;
+  static std::map<Opcode,Instr>const inst2info;
+  static std::vector<Instr const*>const instrtab;    // indexed by opcode (used when running a verified program)
 
   // helper methods
+  std::vector<ProgElement>&mutprog();
   void popstack(std::size_t n2pop=1);
   void pushstack(Value const&v);
+  void pushstack(Value&&v);
   Value const&stackval(size_t offset=0)const;
   size_t incpc();
   Instr const&nextinstr();
   Value const&nextprogval();
-  std::pair<bool,std::string>getvar(std::string const&name)const;
+  std::pair<bool,std::string>getvar(std::string const&name);
+  std::pair<bool,std::string>getenvvar(std::string const&name);
+  std::pair<bool,std::string>execcmd(std::string const&cmd);
+  void begin(Mmvm const*prev,bool async);
+  RunState loop();
+  bool fetchcode();
+  bool canreplay(StmtTrace const&prevtrace,Mmvm const&prev)const;
+  void replay(StmtTrace const&prevtrace);
+  void addsymtab(std::string const&name);
+  void traceenvread(std::string const&name,std::string const*val);
+  void tracestmt(std::size_t stmtno,bool replayed,bool failed);
+  void tracecmd(std::string const&cmd,std::size_t addr,std::chrono::steady_clock::time_point start,bool ok,bool cached);
 
   // instructions executing opcodes
   static void stop(Mmvm*);
@@ -119,5 +318,12 @@ private:
   static void push_ns(Mmvm*);
   static void pop_ns(Mmvm*);
   static void add_sym(Mmvm*);
+  static void push_ttl(Mmvm*);
+  static void pop_ttl(Mmvm*);
+  static void push_env_opt(Mmvm*);
+  static void jmp_nonempty(Mmvm*);
+  static void concat(Mmvm*);
+  static void make_list(Mmvm*);
+  static void make_map(Mmvm*);
 };
 }
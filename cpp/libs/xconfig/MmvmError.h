@@ -21,7 +21,15 @@ public:
     EXPECT_STRING,                       // expected string as operand
     NOSUCH_ENVVAR,                       // environment variable not set in environment
     SHELL_ERROR,                         // error while executing an external program using the shell
-    INTERP_ERROR                         // error while interpolating string
+    INTERP_ERROR,                        // error while interpolating string
+    SHELL_TIMEOUT,                       // external program killed since timeout or deadline passed
+    EXPECT_INT,                          // expected int as operand
+    INVALID_OPCODE,                      // program slot contains an unknown opcode
+    INVALID_JUMP,                        // jump target is not an instruction following the jump
+    TYPE_ERROR,                          // operation not supported for type of value
+    DUPLICATE_KEY,                       // key occurs more than once in a map
+    STACK_UNDERFLOW,                     // instruction pops more elements than there are on the stack
+    STACK_MISMATCH                       // paths reaching an instruction leave different #of elements on the stack
   };
   // ctor,assign,dtor
   MmvmError(std::size_t addr,error errcd);
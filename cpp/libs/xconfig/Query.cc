@@ -0,0 +1,94 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/Query.h"
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+using namespace std;
+namespace xconfig{
+
+namespace{
+// get literal prefix of a regular expression (ECMAScript grammar)
+// (every string matched by the regular expression starts with the prefix - scanning stops at the first construct that
+//  is not a literal character, and an expression containing '|' has no prefix)
+string literalprefix(string const&rstr){
+  if(rstr.find('|')!=string::npos)return "";
+  string ret;
+  size_t i=0;
+  if(i<rstr.size()&&rstr[i]=='^')++i;
+  while(i<rstr.size()){
+    char c=rstr[i];
+    size_t next=i+1;
+    if(c=='\\'){
+      // only escaped punctuation is a literal ('\d', '\w', '\x41' etc. are not)
+      if(next==rstr.size()||!ispunct(static_cast<unsigned char>(rstr[next])))break;
+      c=rstr[next++];
+    }else if(strchr(".[]()*+?{}^$",c)){
+      break;
+    }
+    // a character followed by a quantifier may not be part of the match ('+' requires at least one)
+    if(next<rstr.size()&&strchr("*?{",rstr[next]))break;
+    ret+=c;
+    if(next<rstr.size()&&rstr[next]=='+')break;
+    i=next;
+  }
+  return ret;
+}
+// check if 'name' starts with 'prefix'
+bool startswith(string const&name,string const&prefix){
+  return name.compare(0,prefix.size(),prefix)==0;
+}
+// sort and remove duplicates
+vector<string>sorted(vector<string>v){
+  sort(v.begin(),v.end());
+  v.erase(unique(v.begin(),v.end()),v.end());
+  return v;
+}
+}
+// ctors
+Query::Query():Query(QueryRules{}){
+}
+Query::Query(QueryRules const&rules):rules_(rules),names_(sorted(rules.names)),exclnames_(sorted(rules.exclnames)){
+  for(auto const&ns:rules.nss)nss_.push_back(ns+".");
+  for(auto const&ns:rules.exclnss)exclnss_.push_back(ns+".");
+  for(auto const&r:rules.regexes)regexes_.push_back(Regex{literalprefix(r),std::regex(r)});
+  for(auto const&r:rules.exclregexes)exclregexes_.push_back(Regex{literalprefix(r),std::regex(r)});
+
+  // collect prefixes of include rules and keep only the shortest of overlapping prefixes
+  // (no include rules selects all names - the empty prefix)
+  vector<string>prefixes(names_);
+  prefixes.insert(prefixes.end(),nss_.begin(),nss_.end());
+  for(auto const&r:regexes_)prefixes.push_back(r.prefix);
+  if(prefixes.empty())prefixes.push_back("");
+  for(auto const&p:sorted(std::move(prefixes))){
+    if(ranges_.size()&&startswith(p,ranges_.back()))continue;
+    ranges_.push_back(p);
+  }
+}
+// check if a variable name is selected
+bool Query::match(string const&name)const{
+  bool all=names_.empty()&&nss_.empty()&&regexes_.empty();
+  if(!all&&!matchany(name,names_,nss_,regexes_))return false;
+  return !matchany(name,exclnames_,exclnss_,exclregexes_);
+}
+// get selected variables
+map<string,Mmvm::Value>Query::operator()(map<string,Mmvm::Value>const&mem)const{
+  map<string,Mmvm::Value>ret;
+  foreach(mem,[&ret](string const&name,Mmvm::Value const&value){ret.emplace_hint(ret.end(),name,value);});
+  return ret;
+}
+// getters
+QueryRules const&Query::rules()const noexcept{return rules_;}
+
+// check if a name matches any name, namespace or regular expression
+// (a regular expression is only tried if the name starts with its literal prefix)
+bool Query::matchany(string const&name,vector<string>const&names,vector<string>const&nss,vector<Regex>const&rs){
+  if(binary_search(names.begin(),names.end(),name))return true;
+  for(auto const&ns:nss){
+    if(name.size()>ns.size()&&startswith(name,ns))return true;
+  }
+  for(auto const&r:rs){
+    if(startswith(name,r.prefix)&&regex_match(name,r.re))return true;
+  }
+  return false;
+}
+}
@@ -0,0 +1,79 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include "xconfig/Mmvm.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <regex>
+namespace xconfig{
+
+// rules selecting variables
+// (a variable is selected if it matches any include rule and no exclude rule - no include rules selects all variables)
+struct QueryRules{
+  std::vector<std::string>names;        // variable names
+  std::vector<std::string>nss;          // namespaces
+  std::vector<std::string>regexes;      // regular expressions matched against variable names
+  std::vector<std::string>exclnames;    // variable names to exclude
+  std::vector<std::string>exclnss;      // namespaces to exclude
+  std::vector<std::string>exclregexes;  // regular expressions for variable names to exclude
+};
+// query compiled from a set of rules
+// (regular expressions are compiled once, the literal prefix of each include rule is used for jumping directly to the
+//  range of variable names the rule can match - a query is evaluated in one ordered pass over the memory of a vm)
+class Query{
+public:
+  // ctor,assign,dtor
+  // (throws std::regex_error if a regular expression is invalid)
+  Query();
+  explicit Query(QueryRules const&rules);
+  Query(Query const&)=default;
+  Query(Query&&)=default;
+  Query&operator=(Query const&)=default;
+  Query&operator=(Query&&)=default;
+  ~Query()=default;
+
+  // check if a variable name is selected
+  bool match(std::string const&name)const;
+
+  // call 'f(name,value)' for each selected variable (in name order)
+  template<typename F>
+  void foreach(std::map<std::string,Mmvm::Value>const&mem,F&&f)const;
+
+  // get selected variables
+  std::map<std::string,Mmvm::Value>operator()(std::map<std::string,Mmvm::Value>const&mem)const;
+
+  // getters
+  QueryRules const&rules()const noexcept;
+private:
+  // a compiled regular expression + literal prefix of all names it can match
+  struct Regex{
+    std::string prefix;
+    std::regex re;
+  };
+  // helper methods
+  static bool matchany(std::string const&name,std::vector<std::string>const&names,std::vector<std::string>const&nss,std::vector<Regex>const&rs);
+
+  // private data
+  QueryRules rules_;
+  std::vector<std::string>names_;       // sorted
+  std::vector<std::string>nss_;         // namespaces as prefixes ('<ns>.')
+  std::vector<Regex>regexes_;
+  std::vector<std::string>exclnames_;   // sorted
+  std::vector<std::string>exclnss_;
+  std::vector<Regex>exclregexes_;
+  std::vector<std::string>ranges_;      // sorted prefixes of names that can be selected - no prefix is a prefix of another
+};
+// call 'f(name,value)' for each selected variable
+// (iterator only moves forward - it jumps to the start of each prefix range that is ahead of it)
+template<typename F>
+void Query::foreach(std::map<std::string,Mmvm::Value>const&mem,F&&f)const{
+  auto it=mem.begin();
+  for(auto const&p:ranges_){
+    if(it==mem.end())break;
+    if(it->first<p)it=mem.lower_bound(p);
+    for(;it!=mem.end()&&it->first.compare(0,p.size(),p)==0;++it){
+      if(match(it->first))f(it->first,it->second);
+    }
+  }
+}
+}
@@ -0,0 +1,142 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/Snapshot.h"
+#include <istream>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+using namespace std;
+namespace xconfig{
+
+// helpers
+namespace{
+// first line of a snapshot file
+string const snapshothdr="xconfig-snapshot 1";
+
+// encode an element of a list or map ('i<int>\n' or 's<len>\n<string>')
+void encodeelem(string&buf,List::Elem const&el){
+  if(holds_alternative<int>(el)){
+    buf+='i'+to_string(get<int>(el))+'\n';
+  }else{
+    string_view sval=get<string_view>(el);
+    buf+='s'+to_string(sval.size())+'\n';
+    buf.append(sval);
+  }
+}
+// decode an element of a list or map starting at 'pos'
+// (the element is added to 'l')
+void decodeelem(string const&buf,size_t&pos,List&l){
+  size_t eol=buf.find('\n',pos);
+  if(pos>=buf.size()||eol==string::npos)throw runtime_error("invalid encoding of list or map");
+  char type=buf[pos];
+  string num=buf.substr(pos+1,eol-pos-1);
+  pos=eol+1;
+  if(type=='i'){
+    l.push_back(stoi(num));
+  }else if(type=='s'){
+    size_t len=stoul(num);
+    if(pos+len>buf.size())throw runtime_error("invalid encoding of list or map");
+    l.push_back(string_view(buf).substr(pos,len));
+    pos+=len;
+  }else{
+    throw runtime_error("invalid encoding of list or map");
+  }
+}
+}
+// encode a variable
+void encodeentry(string&buf,string const&name,Mmvm::Value const&value){
+  char type;
+  string sval;
+  if(holds_alternative<string>(value)){
+    type='s';
+    sval=get<string>(value);
+  }else if(holds_alternative<int>(value)){
+    type='i';
+    sval=to_string(get<int>(value));
+  }else if(holds_alternative<List>(value)){
+    type='l';
+    List const&l=get<List>(value);
+    sval=to_string(l.size())+'\n';
+    for(size_t i=0;i<l.size();++i)encodeelem(sval,l[i]);
+  }else{
+    type='m';
+    Map const&m=get<Map>(value);
+    sval=to_string(m.size())+'\n';
+    for(size_t i=0;i<m.size();++i){
+      encodeelem(sval,m.key(i));
+      encodeelem(sval,m.value(i));
+    }
+  }
+  buf+=type+" "s+to_string(name.size())+" "+to_string(sval.size())+"\n";
+  buf+=name;
+  buf+=sval;
+}
+// decode a value encoded by 'encodeentry'
+Mmvm::Value decodevalue(char type,string const&sval){
+  if(type=='s')return sval;
+  if(type=='i')return stoi(sval);
+  if(type!='l'&&type!='m')throw runtime_error("invalid value type: '"s+type+"'");
+  size_t eol=sval.find('\n');
+  if(eol==string::npos)throw runtime_error("invalid encoding of list or map");
+  size_t n=stoul(sval.substr(0,eol));
+  size_t pos=eol+1;
+  List l;
+  for(size_t i=0;i<(type=='l'?n:2*n);++i)decodeelem(sval,pos,l);
+  if(pos!=sval.size())throw runtime_error("invalid encoding of list or map");
+  if(type=='l')return l;
+  Map m;
+  for(size_t i=0;i<n;++i){
+    if(l.isint(2*i)||!m.insert(l.getstring(2*i),l[2*i+1]))throw runtime_error("invalid encoding of map");
+  }
+  return m;
+}
+// write evaluated variables to a snapshot file
+void writesnapshot(ostream&os,map<string,Mmvm::Value>const&mem){
+  os<<snapshothdr<<'\n';
+  string buf;
+  for(auto const&[name,value]:mem){
+    buf.clear();
+    encodeentry(buf,name,value);
+    os<<buf;
+  }
+  os.flush();
+  if(!os)throw runtime_error("failed writing snapshot");
+}
+// check if a file is a snapshot file
+bool issnapshot(string const&path){
+  ifstream is(path.c_str(),ifstream::in);
+  string hdr;
+  return is&&getline(is,hdr)&&hdr==snapshothdr;
+}
+// ctor
+SnapshotReader::SnapshotReader(istream&is):is_(is),done_(false){
+  string hdr;
+  if(!getline(is_,hdr)||hdr!=snapshothdr)throw runtime_error("not a snapshot file (expected header '"s+snapshothdr+"')");
+  next();
+}
+// current variable
+bool SnapshotReader::done()const noexcept{return done_;}
+string const&SnapshotReader::name()const noexcept{return name_;}
+Mmvm::Value const&SnapshotReader::value()const noexcept{return value_;}
+
+// move to next variable
+void SnapshotReader::next(){
+  if(done_)return;
+  string line;
+  if(!getline(is_,line)){
+    if(is_.eof())done_=true;
+    else throw runtime_error("failed reading snapshot");
+    return;
+  }
+  char type;
+  size_t namelen,valuelen;
+  stringstream hdr(line);
+  if(!(hdr>>type>>namelen>>valuelen))throw runtime_error("invalid entry in snapshot: '"s+line+"'");
+  string buf(namelen+valuelen,'\0');
+  if(!is_.read(buf.data(),buf.size()))throw runtime_error("truncated snapshot");
+  string name=buf.substr(0,namelen);
+  if(name_.size()&&name<=name_)throw runtime_error("variables in snapshot are not sorted on name: '"s+name+"' after '"+name_+"'");
+  value_=decodevalue(type,buf.substr(namelen));
+  name_=std::move(name);
+}
+}
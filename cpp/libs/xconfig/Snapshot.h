@@ -0,0 +1,48 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include "xconfig/Mmvm.h"
+#include <string>
+#include <map>
+#include <iosfwd>
+namespace xconfig{
+
+// encoding of a single variable (used by snapshot files and by the config server protocol)
+// (entry: '<s|i|l|m> <namelen> <valuelen>\n<name><value>' - a list/map value is '<size>\n' followed by
+//  elements/key-value pairs 'i<int>\n' or 's<len>\n<string>')
+void encodeentry(std::string&buf,std::string const&name,Mmvm::Value const&value);
+Mmvm::Value decodevalue(char type,std::string const&sval);   // (throws std::runtime_error if value is invalid)
+
+// write evaluated variables to a snapshot file
+// (file: 'xconfig-snapshot 1\n' followed by one entry per variable in name order)
+void writesnapshot(std::ostream&os,std::map<std::string,Mmvm::Value>const&mem);
+
+// check if a file is a snapshot file
+bool issnapshot(std::string const&path);
+
+// read a snapshot file one variable at a time
+// (reader is positioned on the first variable after construction - throws std::runtime_error if the file is invalid or
+//  its variables are not in strictly increasing name order)
+class SnapshotReader{
+public:
+  // ctor,assign,dtor
+  explicit SnapshotReader(std::istream&is);
+  SnapshotReader(SnapshotReader const&)=delete;
+  SnapshotReader(SnapshotReader&&)=default;
+  SnapshotReader&operator=(SnapshotReader const&)=delete;
+  SnapshotReader&operator=(SnapshotReader&&)=delete;
+  ~SnapshotReader()=default;
+
+  // current variable (only valid if not done)
+  bool done()const noexcept;
+  std::string const&name()const noexcept;
+  Mmvm::Value const&value()const noexcept;
+
+  // move to next variable
+  void next();
+private:
+  std::istream&is_;
+  bool done_;
+  std::string name_;
+  Mmvm::Value value_;
+};
+}
@@ -43,6 +43,22 @@ optional<string>Symtab::lookupsym(string const&name)const{
   }
   return optional<string>{};
 }
+// (lookup using 'exists' to check if a fully qualified name exists instead of the symbols in the table)
+optional<string>Symtab::lookupsym(string const&name,function<bool(string const&)>const&exists)const{
+  for(size_t i=0;i<=nsstack_.size();++i){
+    string fqname;
+    if(i==nsstack_.size())fqname=name;
+    else fqname=nsstack_[nsstack_.size()-i-1]+NSSEP+name;
+    if(exists(fqname))return fqname;
+  }
+  return optional<string>{};
+}
+bool Symtab::hassym(string const&fqname)const{
+  return symtab_.count(fqname)!=0;
+}
+set<string>const&Symtab::syms()const noexcept{
+  return symtab_;
+}
 string Symtab::addsym(string const&name){
   string fqname=fullyQualifiedName(name);
   if(symtab_.count(fqname)){
@@ -60,4 +76,14 @@ bool Symtab::isSimpleSymbol(std::string const&name)const{
 string Symtab::fullyQualifiedName(std::string const&name)const{
   return nsstack_.empty()?name:currentns()+NSSEP+name;
 }
+// memory used by namespaces and symbols
+SizeStats Symtab::memusage()const noexcept{
+  SizeStats ret;
+  ret.nelems=nstab_.size()+symtab_.size();
+  ret.bytes=nsstack_.capacity()*sizeof(string);
+  for(auto const&ns:nsstack_)ret.bytes+=heapbytes(ns);
+  for(auto const&ns:nstab_)ret.bytes+=TREENODEBYTES+sizeof(string)+heapbytes(ns);
+  for(auto const&sym:symtab_)ret.bytes+=TREENODEBYTES+sizeof(string)+heapbytes(sym);
+  return ret;
+}
 }
@@ -1,9 +1,11 @@
 // (C) Copyright Hans Ewetz 2018. All rights reserved.
 #pragma once
+#include "xconfig/MemStats.h"
 #include <string>
 #include <vector>
 #include <set>
 #include <optional>
+#include <functional>
 #include <iosfwd>
 namespace xconfig{
 // symbol table used during parsing/compilatin
@@ -25,9 +27,15 @@ public:
 
   // symbol management
   std::optional<std::string>lookupsym(std::string const&name)const;
+  std::optional<std::string>lookupsym(std::string const&name,std::function<bool(std::string const&)>const&exists)const;
+  bool hassym(std::string const&fqname)const;
+  std::set<std::string>const&syms()const noexcept;
   std::string addsym(std::string const&name);
   bool isSimpleSymbol(std::string const&name)const;
   std::string fullyQualifiedName(std::string const&name)const;
+
+  // memory used by namespaces and symbols
+  SizeStats memusage()const noexcept;
 private:
   // private data
   std::vector<std::string>nsstack_; // track current namespace
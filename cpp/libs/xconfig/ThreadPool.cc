@@ -0,0 +1,46 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/ThreadPool.h"
+using namespace std;
+namespace xconfig{
+
+// ctor
+ThreadPool::ThreadPool(size_t nthreads):stop_(false){
+  if(nthreads==0)nthreads=max(1u,thread::hardware_concurrency());
+  for(size_t i=0;i<nthreads;++i)threads_.emplace_back(&ThreadPool::worker,this);
+}
+// dtor
+ThreadPool::~ThreadPool(){
+  {
+    lock_guard<mutex>lock(mtx_);
+    stop_=true;
+  }
+  cond_.notify_all();
+  for(auto&t:threads_)t.join();
+}
+// #of threads in pool
+size_t ThreadPool::size()const noexcept{
+  return threads_.size();
+}
+// queue a task
+void ThreadPool::enqueue(function<void()>f){
+  {
+    lock_guard<mutex>lock(mtx_);
+    tasks_.push_back(move(f));
+  }
+  cond_.notify_one();
+}
+// worker thread - execute tasks until pool is stopped and queue is empty
+void ThreadPool::worker(){
+  while(true){
+    function<void()>task;
+    {
+      unique_lock<mutex>lock(mtx_);
+      cond_.wait(lock,[this](){return stop_||!tasks_.empty();});
+      if(tasks_.empty())return;
+      task=move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+}
@@ -0,0 +1,50 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+namespace xconfig{
+
+// simple fixed size thread pool executing tasks in fifo order
+class ThreadPool{
+public:
+  // ctor,assign,dtor
+  // (nthreads == 0 --> one thread per core)
+  explicit ThreadPool(std::size_t nthreads=0);
+  ThreadPool(ThreadPool const&)=delete;
+  ThreadPool(ThreadPool&&)=delete;
+  ThreadPool&operator=(ThreadPool const&)=delete;
+  ThreadPool&operator=(ThreadPool&&)=delete;
+  ~ThreadPool();                        // waits until all queued tasks have been executed
+
+  // submit a task - result (or exception) is delivered through the returned future
+  template<typename F>
+  std::future<std::invoke_result_t<F>>submit(F&&f){
+    using R=std::invoke_result_t<F>;
+    auto task=std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+    auto ret=task->get_future();
+    enqueue([task](){(*task)();});
+    return ret;
+  }
+  // #of threads in pool
+  std::size_t size()const noexcept;
+private:
+  // helper methods
+  void enqueue(std::function<void()>f);
+  void worker();
+
+  // private data
+  std::vector<std::thread>threads_;
+  std::deque<std::function<void()>>tasks_;
+  std::mutex mtx_;
+  std::condition_variable cond_;
+  bool stop_;
+};
+}
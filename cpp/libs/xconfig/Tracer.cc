@@ -0,0 +1,78 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/Tracer.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+using namespace std;
+namespace xconfig{
+
+// helpers
+namespace{
+// convert a string to a JSON string literal
+string jsonstring(string const&str){
+  stringstream ret;
+  ret<<'"';
+  for(unsigned char c:str){
+    if(c=='"'||c=='\\')ret<<'\\'<<c;
+    else if(c=='\n')ret<<"\\n";
+    else if(c=='\t')ret<<"\\t";
+    else if(c<0x20)ret<<"\\u"<<hex<<setw(4)<<setfill('0')<<static_cast<int>(c)<<dec;
+    else ret<<c;
+  }
+  ret<<'"';
+  return ret.str();
+}
+// microseconds between two time points
+string us(Tracer::Clock::time_point from,Tracer::Clock::time_point to){
+  stringstream ret;
+  ret<<fixed<<setprecision(3)<<chrono::duration<double,micro>(to-from).count();
+  return ret.str();
+}
+}
+// ctor
+Tracer::Tracer(string const&procname):procname_(procname),epoch_(Clock::now()){
+}
+// record a complete event
+void Tracer::complete(string const&name,string const&cat,Clock::time_point start,Clock::time_point end,Args const&args){
+  lock_guard<mutex>lock(mtx_);
+  events_.push_back(Event{name,cat,tid(),start,end,args});
+}
+// name calling thread
+void Tracer::threadname(string const&name){
+  lock_guard<mutex>lock(mtx_);
+  tnames_[tid()]=name;
+}
+// write chrome trace event JSON
+void Tracer::writejson(ostream&os)const{
+  lock_guard<mutex>lock(mtx_);
+  os<<"{\"traceEvents\":["<<endl;
+  os<<"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":"<<jsonstring(procname_)<<"}}";
+  for(auto const&[tid,name]:tnames_){
+    os<<","<<endl<<"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"<<tid<<",\"args\":{\"name\":"<<jsonstring(name)<<"}}";
+  }
+  for(auto const&ev:events_){
+    os<<","<<endl<<"{\"name\":"<<jsonstring(ev.name)<<",\"cat\":"<<jsonstring(ev.cat)<<",\"ph\":\"X\",\"pid\":1,\"tid\":"<<ev.tid
+      <<",\"ts\":"<<us(epoch_,ev.start)<<",\"dur\":"<<us(ev.start,ev.end)<<",\"args\":{";
+    for(size_t i=0;i<ev.args.size();++i){
+      if(i)os<<",";
+      os<<jsonstring(ev.args[i].first)<<":"<<jsonstring(ev.args[i].second);
+    }
+    os<<"}}";
+  }
+  os<<endl<<"],\"displayTimeUnit\":\"ms\"}"<<endl;
+}
+// #of recorded events
+size_t Tracer::size()const{
+  lock_guard<mutex>lock(mtx_);
+  return events_.size();
+}
+// get small integer id of calling thread
+// (must be called with mutex locked)
+int Tracer::tid(){
+  auto it=tids_.find(this_thread::get_id());
+  if(it!=tids_.end())return it->second;
+  int ret=tids_.size()+1;
+  tids_[this_thread::get_id()]=ret;
+  return ret;
+}
+}
@@ -0,0 +1,61 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <iosfwd>
+namespace xconfig{
+
+// timeline of compile phases, executed statements and executed commands
+// (written as chrome trace event JSON - load it in chrome://tracing or https://ui.perfetto.dev)
+// (thread safe - events are recorded on the thread they were measured on)
+class Tracer{
+public:
+  // typedefs
+  using Clock=std::chrono::steady_clock;
+  using Args=std::vector<std::pair<std::string,std::string>>;
+
+  // ctor,assign,dtor
+  explicit Tracer(std::string const&procname="xconfig");
+  Tracer(Tracer const&)=delete;
+  Tracer(Tracer&&)=delete;
+  Tracer&operator=(Tracer const&)=delete;
+  Tracer&operator=(Tracer&&)=delete;
+  ~Tracer()=default;
+
+  // record an event which started at 'start' and ended at 'end'
+  void complete(std::string const&name,std::string const&cat,Clock::time_point start,Clock::time_point end,Args const&args={});
+
+  // name the calling thread in the trace
+  void threadname(std::string const&name);
+
+  // write events as chrome trace event JSON
+  void writejson(std::ostream&os)const;
+
+  // #of recorded events
+  std::size_t size()const;
+private:
+  // a complete event
+  struct Event{
+    std::string name;
+    std::string cat;
+    int tid;
+    Clock::time_point start;
+    Clock::time_point end;
+    Args args;
+  };
+  // helper methods
+  int tid();
+
+  // private data
+  std::string procname_;
+  Clock::time_point epoch_;             // timestamps are relative to when the tracer was created
+  mutable std::mutex mtx_;
+  std::vector<Event>events_;
+  std::map<std::thread::id,int>tids_;
+  std::map<int,std::string>tnames_;
+};
+}
@@ -2,74 +2,390 @@
 #include "xconfig/XConfig.h"
 #include "xconfig/driver.h"
 #include "xconfig/Mmvm.h"
-#include <strstream>
+#include "xconfig/CodeQueue.h"
+#include "xconfig/parcompile.h"
+#include <sstream>
+#include <thread>
 #include <memory>
 #include <stdexcept>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 using namespace std;
 using namespace xconfig;
 namespace xconfig{
 
-// ctors
-XConfig::XConfig():vm_(make_shared<Mmvm>()),basicx_(vm_){
-  compileAndRun(cin,"stdin");
+// helper functions
+namespace{
+// create environment overlay from options
+shared_ptr<Environment>makeenv(XConfigOptions const&opts){
+  return opts.env?make_shared<Environment>(opts.env.value()):make_shared<Environment>();
 }
-XConfig::XConfig(string const&cfgpath):vm_(make_shared<Mmvm>()),basicx_(vm_){
-  // open input stream
-  ifstream is(cfgpath.c_str(),ifstream::in);
-  if(!is)throw runtime_error("failed opening file: "s+cfgpath+" for reading");
-  compileAndRun(is,cfgpath);
+// setup vm from options
+void setupvm(Mmvm&vm,XConfigOptions const&opts){
+  // setup limits for executing commands
+  if(opts.cmdtimeout)vm.setcmdtimeout(opts.cmdtimeout.value());
+  if(opts.deadline)vm.setdeadline(chrono::steady_clock::now()+opts.deadline.value());
+  vm.setshellmode(opts.shellmode);
+  if(opts.tracer)vm.settracer(opts.tracer);
+
+  // setup cache for command output
+  // (no cache if no directory is given and there is no default directory)
+  optional<string>cachedir=opts.cachedir?opts.cachedir:CmdCache::defaultdir(vm.env());
+  if(opts.cachemode!=CmdCache::Mode::off&&cachedir){
+    vm.setcache(make_shared<CmdCache>(cachedir.value(),opts.cachemode));
+    if(opts.cachettl)vm.setcachettl(opts.cachettl.value());
+  }
 }
-XConfig::XConfig(istream&is,string const&name):vm_(make_shared<Mmvm>()),basicx_(vm_){
-  compileAndRun(is,name);
+// write environment overlay back to process environment if requested
+void exportvmenv(Mmvm const&vm,string const&name,XConfigOptions const&opts){
+  if(!opts.exportenv)return;
+  auto enverr=vm.env().exportenv();
+  if(enverr)throw runtime_error("failed exporting environment after evaluating: "s+name+", error: "+enverr.value());
 }
-// compile and run from an input stream
-void XConfig::compileAndRun(istream&is,string const&name){
+// get names of variables which were added, removed or changed value
+vector<string>diffmem(map<string,Mmvm::Value>const&oldmem,map<string,Mmvm::Value>const&newmem){
+  vector<string>ret;
+  auto oldit=oldmem.begin();
+  auto newit=newmem.begin();
+  while(oldit!=oldmem.end()||newit!=newmem.end()){
+    if(newit==newmem.end()||(oldit!=oldmem.end()&&oldit->first<newit->first)){
+      ret.push_back((oldit++)->first);
+    }else if(oldit==oldmem.end()||newit->first<oldit->first){
+      ret.push_back((newit++)->first);
+    }else{
+      if(oldit->second!=newit->second)ret.push_back(oldit->first);
+      ++oldit;++newit;
+    }
+  }
+  return ret;
+}
+// record a phase of loading a configuration in timeline trace (if traced)
+void tracephase(Tracer*tracer,string const&phase,string const&name,Tracer::Clock::time_point start){
+  if(tracer)tracer->complete(phase,"phase",start,Tracer::Clock::now(),{{"config",name}});
+}
+// record allocations made while compiling and size of compile time symbol table
+// (allocations made while parsing include allocations made while scanning)
+void recordcompile(MemoryStats&memstats,comp_driver&driver,AllocStats parsestats){
+  parsestats-=driver.scanstats();
+  memstats.phases["scan"]=driver.scanstats();
+  memstats.phases["parse"]=parsestats;
+  memstats.structs["symtab-compile"]=driver.symtab().memusage();
+}
+// run a vm counting allocations in 'memstats'
+void runvm(Mmvm&vm,MemoryStats&memstats){
+  AllocScope scope(memstats.phases["run"]);
+  vm.run();
+}
+// compile and validate program into a vm
+// (allocations are counted per phase in 'memstats' if set)
+// (if 'nthreads' is not 1 blocks of the configuration are compiled in parallel - the configuration is compiled sequentially
+//  if it cannot be split or fails compiling so that errors are reported as usual)
+void compileinto(shared_ptr<Mmvm>vm,istream&is,string const&name,Tracer*tracer=nullptr,MemoryStats*memstats=nullptr,size_t nthreads=1){
+  optional<istringstream>srcis;
+  if(nthreads!=1){
+    string src(istreambuf_iterator<char>(is),istreambuf_iterator<char>{});
+    auto start=Tracer::Clock::now();
+    if(compileparallel(vm,src,name,nthreads,memstats)){
+      tracephase(tracer,"compile",name,start);
+      return;
+    }
+    srcis.emplace(std::move(src));
+  }
+  istream&in=srcis?srcis.value():is;
+
   // setup for compilation
-  strstream errstr;
-  comp_driver driver(vm_,errstr);
+  stringstream errstr;
+  comp_driver driver(vm,errstr);
   driver.trace_scanning(false);    // NOTE! hard coded
   driver.trace_parsing(false);     // ...
 
   // parse/compile file
-  if(!driver.parse(is,name)){
+  AllocStats parsestats;
+  auto start=Tracer::Clock::now();
+  bool ok=[&]{AllocScope scope(parsestats);return driver.parse(in,name);}();
+  tracephase(tracer,"compile",name,start);
+  if(memstats)recordcompile(*memstats,driver,parsestats);
+  if(!ok){
     throw runtime_error("failed compiling input file: "s+name+", error: "+errstr.str());
   }
   // validate generated code
-  auto vmerr=vm_->validatecode();
-  if(vmerr){
+  AllocStats validatestats;
+  start=Tracer::Clock::now();
+  auto vmerr=[&]{AllocScope scope(validatestats);return vm->verifycode();}();
+  tracephase(tracer,"validate",name,start);
+  if(memstats)memstats->phases["validate"]=validatestats;
+  if(!vmerr){
     throw runtime_error("<internal compilation error> - failed validating generated bytecode, error: "s+vmerr.tostring());
   }
-  // run program
-  vm_->run();
+}
+// compile program and run it concurrently
+// (the vm runs on a separate thread executing code as soon as each statement has been compiled and validated)
+// (errors are reported as if compiling and running were sequential - a compilation error takes precedence over an
+//  error from running the program, however, commands in statements preceding the compilation error may have been executed)
+// (validation is done while parsing - allocations made when validating are counted as parsing)
+void compileandrun(shared_ptr<Mmvm>vm,istream&is,string const&name,Tracer*tracer=nullptr,MemoryStats*memstats=nullptr){
+  // start vm - on failure the queue is closed so the compiler stops passing code to it
+  CodeQueue queue;
+  exception_ptr runerr;
+  AllocStats runstats;
+  thread runner([&](){
+    if(tracer)tracer->threadname("vm");
+    auto start=Tracer::Clock::now();
+    try{
+      AllocScope scope(runstats);
+      vm->runpipelined(queue);
+    }
+    catch(...){
+      runerr=current_exception();
+      queue.close();
+    }
+    tracephase(tracer,"run",name,start);
+  });
+  // setup for compilation
+  // (code is compiled into a separate vm and passed to the running vm in blocks)
+  if(tracer)tracer->threadname("compile");
+  stringstream errstr;
+  comp_driver driver(make_shared<Mmvm>(),errstr);
+  driver.trace_scanning(false);    // NOTE! hard coded
+  driver.trace_parsing(false);     // ...
+  driver.setcodequeue(&queue);
+
+  // parse/compile file
+  bool ok;
+  AllocStats parsestats;
+  auto start=Tracer::Clock::now();
+  try{
+    AllocScope scope(parsestats);
+    ok=driver.parse(is,name);
+  }
+  catch(...){
+    queue.close();
+    runner.join();
+    throw;
+  }
+  tracephase(tracer,"compile",name,start);
+  if(!ok)queue.close();
+  runner.join();
+  if(memstats){
+    recordcompile(*memstats,driver,parsestats);
+    memstats->phases["run"]=runstats;
+  }
+  if(!ok){
+    throw runtime_error("failed compiling input file: "s+name+", error: "+errstr.str());
+  }
+  // check validation of generated code
+  if(driver.codeerror()){
+    throw runtime_error("<internal compilation error> - failed validating generated bytecode, error: "s+driver.codeerror().value().tostring());
+  }
+  if(runerr)rethrow_exception(runerr);
+}
+// convert an embedded program to a vm program
+vector<Mmvm::ProgElement>embedded2prog(EmbeddedProgram const&eprog){
+  if(eprog.formatversion!=EMBEDDED_FORMAT_VERSION){
+    throw runtime_error("embedded program: "s+eprog.name+" has format version "+to_string(eprog.formatversion)+
+                        " - expected version "+to_string(EMBEDDED_FORMAT_VERSION)+" (regenerate program with xconfigc)");
+  }
+  vector<Mmvm::ProgElement>ret;
+  ret.reserve(eprog.size);
+  for(size_t i=0;i<eprog.size;++i){
+    EmbeddedElement const&el=eprog.elements[i];
+    switch(el.kind){
+    case EmbeddedElement::opcode:
+      ret.emplace_back(in_place_type<Mmvm::Opcode>,static_cast<Mmvm::Opcode>(el.ival));
+      break;
+    case EmbeddedElement::intval:
+      ret.emplace_back(in_place_type<Mmvm::Value>,el.ival);
+      break;
+    case EmbeddedElement::strval:
+      ret.emplace_back(in_place_type<Mmvm::Value>,string(el.sval,el.slen));
+      break;
+    default:
+      throw runtime_error("embedded program: "s+eprog.name+" contains invalid element at address "+to_string(i));
+    }
+  }
+  return ret;
+}
+}
+// ctors
+XConfig::XConfig():vm_(make_shared<Mmvm>()),basicx_(vm_){
+  compileAndRun(cin,"stdin",XConfigOptions{});
+}
+XConfig::XConfig(string const&cfgpath):XConfig(cfgpath,XConfigOptions{}){
+}
+XConfig::XConfig(istream&is,string const&name):XConfig(is,name,XConfigOptions{}){
+}
+XConfig::XConfig(string const&cfgpath,XConfigOptions const&opts):vm_(make_shared<Mmvm>(makeenv(opts))),basicx_(vm_){
+  // open input stream
+  ifstream is(cfgpath.c_str(),ifstream::in);
+  if(!is)throw runtime_error("failed opening file: "s+cfgpath+" for reading");
+  compileAndRun(is,cfgpath,opts);
+}
+XConfig::XConfig(istream&is,string const&name,XConfigOptions const&opts):vm_(make_shared<Mmvm>(makeenv(opts))),basicx_(vm_){
+  compileAndRun(is,name,opts);
+}
+XConfig::XConfig(EmbeddedProgram const&prog):XConfig(prog,XConfigOptions{}){
+}
+XConfig::XConfig(EmbeddedProgram const&prog,XConfigOptions const&opts):vm_(make_shared<Mmvm>(makeenv(opts))),basicx_(vm_){
+  {
+    AllocScope scope(loadstats_.phases["load"]);
+    vm_->loadprog(*compile(prog));
+  }
+  setupvm(*vm_,opts);
+  auto start=Tracer::Clock::now();
+  runvm(*vm_,loadstats_);
+  tracephase(opts.tracer.get(),"run",prog.name,start);
+  exportvmenv(*vm_,prog.name,opts);
+}
+// wrap a vm which has already run
+XConfig::XConfig(shared_ptr<Mmvm>vm,string const&name,XConfigOptions const&opts):vm_(vm),basicx_(vm_){
+  exportvmenv(*vm_,name,opts);
+}
+// compile program into a new vm without running it
+shared_ptr<Mmvm>XConfig::prepare(istream&is,string const&name,XConfigOptions const&opts){
+  auto ret=make_shared<Mmvm>(makeenv(opts));
+  setupvm(*ret,opts);
+  compileinto(ret,is,name,opts.tracer.get(),nullptr,opts.compilethreads);
+  return ret;
+}
+// run a compiled program in a new vm
+// (the program is shared with 'compiled' - not copied)
+shared_ptr<XConfig>XConfig::runcompiled(Mmvm const&compiled,string const&name,XConfigOptions const&opts){
+  auto vm=make_shared<Mmvm>(makeenv(opts));
+  vm->loadprog(compiled);
+  setupvm(*vm,opts);
+  MemoryStats memstats;
+  auto start=Tracer::Clock::now();
+  runvm(*vm,memstats);
+  tracephase(opts.tracer.get(),"run",name,start);
+  auto ret=shared_ptr<XConfig>(new XConfig(vm,name,opts));
+  ret->loadstats_=std::move(memstats);
+  return ret;
+}
+// re-evaluate configuration incrementally
+vector<string>XConfig::reload(string const&cfgpath,XConfigOptions const&opts){
+  ifstream is(cfgpath.c_str(),ifstream::in);
+  if(!is)throw runtime_error("failed opening file: "s+cfgpath+" for reading");
+  return reload(is,cfgpath,opts);
+}
+vector<string>XConfig::reload(istream&is,string const&name,XConfigOptions const&opts){
+  // compile and run in a new vm replaying unchanged statements from current vm
+  auto vm=make_shared<Mmvm>(makeenv(opts));
+  setupvm(*vm,opts);
+  MemoryStats memstats;
+  compileinto(vm,is,name,opts.tracer.get(),&memstats,opts.compilethreads);
+  auto start=Tracer::Clock::now();
+  {
+    AllocScope scope(memstats.phases["run"]);
+    vm->runincremental(*vm_);
+  }
+  tracephase(opts.tracer.get(),"run",name,start);
+  exportvmenv(*vm,name,opts);
+
+  // switch to new vm
+  auto ret=diffmem(vm_->mem(),vm->mem());
+  vm_=vm;
+  basicx_=BasicExtractor(vm_);
+  loadstats_=std::move(memstats);
+  return ret;
+}
+// compile and validate a configuration without running it
+shared_ptr<Mmvm>XConfig::compile(istream&is,string const&name){
+  auto ret=make_shared<Mmvm>();
+  compileinto(ret,is,name);
+  return ret;
+}
+// load an embedded program into a vm without running it
+// (no scanning or parsing needed - the program is validated when it is loaded so a corrupt program is never run)
+shared_ptr<Mmvm>XConfig::compile(EmbeddedProgram const&prog){
+  auto ret=make_shared<Mmvm>();
+  try{
+    ret->loadprog(embedded2prog(prog));
+  }
+  catch(MmvmError const&e){
+    throw runtime_error("failed validating embedded program: "s+prog.name+", error: "+e.tostring());
+  }
+  for(size_t i=0;i<prog.nstmts;++i)ret->addstmt(prog.stmts[i].begin,prog.stmts[i].end);
+  for(size_t i=0;i<prog.nlines;++i)ret->addline(prog.lines[i].addr,prog.lines[i].line);
+  return ret;
+}
+// compile and run from an input stream
+void XConfig::compileAndRun(istream&is,string const&name,XConfigOptions const&opts){
+  setupvm(*vm_,opts);
+  if(opts.pipelined){
+    compileandrun(vm_,is,name,opts.tracer.get(),&loadstats_);
+  }else{
+    compileinto(vm_,is,name,opts.tracer.get(),&loadstats_,opts.compilethreads);
+    auto start=Tracer::Clock::now();
+    runvm(*vm_,loadstats_);
+    tracephase(opts.tracer.get(),"run",name,start);
+  }
+  exportvmenv(*vm_,name,opts);
 }
 // get basic extractor
 BasicExtractor const&XConfig::basicx()const{return basicx_;}
 
 // simplified operaytions for extracting variables
 map<string,string>XConfig::operator()()const{
+  AllocScope scope(extractstats_,&extractmtx_);
   return basicx_();
 }
 optional<string>XConfig::operator()(string const&name)const{
+  AllocScope scope(extractstats_,&extractmtx_);
   return basicx_(name);
 }
 map<string,optional<string>>XConfig::operator()(vector<string>const&v)const{
+  AllocScope scope(extractstats_,&extractmtx_);
   return basicx_(v);
 }
 map<string,string>XConfig::operator()(regex const&r)const{
+  AllocScope scope(extractstats_,&extractmtx_);
   return basicx_(r);
 }
+map<string,string>XConfig::operator()(Query const&q)const{
+  AllocScope scope(extractstats_,&extractmtx_);
+  return basicx_(q);
+}
 // get variables by Mmvm::Value
 map<string,Mmvm::Value>XConfig::asValue()const{
+  AllocScope scope(extractstats_,&extractmtx_);
   return basicx_.asValue();
 }
 optional<Mmvm::Value>XConfig::asValue(string const&name)const{
+  AllocScope scope(extractstats_,&extractmtx_);
   return basicx_.asValue(name);
 }
+map<string,Mmvm::Value>XConfig::asValue(Query const&q)const{
+  AllocScope scope(extractstats_,&extractmtx_);
+  return basicx_.asValue(q);
+}
+optional<List>XConfig::asList(string const&name)const{
+  AllocScope scope(extractstats_,&extractmtx_);
+  return basicx_.asList(name);
+}
+optional<Map>XConfig::asMap(string const&name)const{
+  AllocScope scope(extractstats_,&extractmtx_);
+  return basicx_.asMap(name);
+}
+// get environment overlay
+Environment const&XConfig::env()const noexcept{return vm_->env();}
+
+// get memory used when loading configuration and size of vm structures
+MemoryStats XConfig::memoryStats()const{
+  MemoryStats ret=loadstats_;
+  ret.counted=allocscounted();
+  {
+    lock_guard<mutex>lock(extractmtx_);
+    ret.phases["extract"]=extractstats_;
+  }
+  for(auto const&[name,size]:vm_->memusage())ret.structs[name]=size;
+  return ret;
+}
+
 // dump vm related information
 void XConfig::dumpprog(ostream&os)const{vm_->dumpprog(os);}
 void XConfig::dumpstack(ostream&os)const{vm_->dumpstack(os);}
 void XConfig::dumpmem(ostream&os)const{vm_->dumpmem(os);}
 void XConfig::dumpsymtab(ostream&os)const{vm_->dumpsymtab(os);}
+void XConfig::dumpdeps(ostream&os)const{vm_->dumpdeps(os);}
 }
@@ -2,6 +2,10 @@
 #pragma once
 #include "xconfig/BasicExtractor.h"
 #include "xconfig/Mmvm.h"
+#include "xconfig/Environment.h"
+#include "xconfig/EmbeddedProgram.h"
+#include "xconfig/Tracer.h"
+#include "xconfig/MemStats.h"
 #include <optional>
 #include <memory>
 #include <string>
@@ -9,11 +13,31 @@
 #include <map>
 #include <iosfwd>
 #include <regex>
-#include <iosfwd>
+#include <chrono>
+#include <mutex>
 namespace xconfig{
 // forward decl
 class Mmvm;
+class AsyncLoader;
+class CompiledConfig;
 
+// options controlling how a configuration is evaluated
+struct XConfigOptions{
+  std::optional<Environment>env;         // environment to evaluate against (default: snapshot of process environment)
+  bool exportenv=false;                  // write environment overlay back to process environment after evaluation
+  std::optional<std::chrono::milliseconds>cmdtimeout;   // max time a single command may execute
+  std::optional<std::chrono::milliseconds>deadline;     // max time for loading the configuration (measured from start of load)
+  Mmvm::ShellMode shellmode=Mmvm::ShellMode::fork;      // execute each command in a new shell or in a shell co-process
+  CmdCache::Mode cachemode=CmdCache::Mode::use;         // how on-disk cache of command output is used
+  std::optional<std::string>cachedir;                   // cache directory (default: CmdCache::defaultdir(...))
+  std::optional<std::chrono::seconds>cachettl;          // cache output of all commands (default: only commands inside 'cache <ttl> <expr>')
+  bool pipelined=false;                                 // run statements on a separate thread while the rest of the configuration is compiled
+                                                        // (only used when a configuration is first loaded - not by 'reload(...)' or AsyncLoader)
+  std::shared_ptr<Tracer>tracer;                        // record compile phases, statements and commands in a timeline trace
+  std::size_t compilethreads=1;                         // compile blocks of the configuration split at top level namespaces on
+                                                        // #of threads (0: one per core, 1: compile sequentially)
+                                                        // (not used when compiling pipelined)
+};
 // interface to xconfig system
 class XConfig{
 public:
@@ -21,12 +45,30 @@ public:
   XConfig();
   XConfig(std::string const&cfgpath);
   XConfig(std::istream&is,std::string const&name);
+  XConfig(std::string const&cfgpath,XConfigOptions const&opts);
+  XConfig(std::istream&is,std::string const&name,XConfigOptions const&opts);
+  XConfig(EmbeddedProgram const&prog);
+  XConfig(EmbeddedProgram const&prog,XConfigOptions const&opts);
   XConfig(XConfig const&)=delete;
   XConfig(XConfig&&)=delete;
   XConfig const&operator=(XConfig const&)=delete;
   XConfig const&operator=(XConfig&&)=delete;
   ~XConfig()=default;
 
+  // re-evaluate configuration incrementally
+  // (configuration is recompiled - only statements which changed, or which read variables, environment variables or
+  //  command output that changed, are executed - other statements are replayed from the previous evaluation)
+  // (returns names of variables that were added, removed or changed value - on failure the configuration is unchanged)
+  std::vector<std::string>reload(std::string const&cfgpath,XConfigOptions const&opts);
+  std::vector<std::string>reload(std::istream&is,std::string const&name,XConfigOptions const&opts);
+
+  // compile and validate a configuration without running it
+  // (used for generating embedded programs - see codegen.h)
+  static std::shared_ptr<Mmvm>compile(std::istream&is,std::string const&name);
+
+  // load an embedded program into a vm without running it
+  static std::shared_ptr<Mmvm>compile(EmbeddedProgram const&prog);
+
   // data extractors
   BasicExtractor const&basicx()const;
 
@@ -36,26 +78,51 @@ public:
   std::optional<std::string>operator()(std::string const&name)const;
   std::map<std::string,std::optional<std::string>>operator()(std::vector<std::string>const&v)const;
   std::map<std::string,std::string>operator()(std::regex const&r)const;
+  std::map<std::string,std::string>operator()(Query const&q)const;
 
   // get by Mmvm::Value
   std::map<std::string,Mmvm::Value>asValue()const;
   std::optional<Mmvm::Value>asValue(std::string const&name)const;
+  std::map<std::string,Mmvm::Value>asValue(Query const&q)const;
+  std::optional<List>asList(std::string const&name)const;
+  std::optional<Map>asMap(std::string const&name)const;
   // ... NOTE! add more methods for retrieving by Mmvm::Value ...
 
+  // environment overlay the configuration was evaluated against
+  Environment const&env()const noexcept;
+
+  // memory used when loading configuration (per phase) and size of vm structures
+  // (allocations are only counted if operator new calls 'countedalloc(...)' - see MemStats.h, allocations made by
+  //  the extraction methods above are counted in phase 'extract')
+  MemoryStats memoryStats()const;
+
   // basic methods for dumping information from vm
   void dumpprog(std::ostream&os)const;
   void dumpstack(std::ostream&os)const;
   void dumpmem(std::ostream&os)const;
   void dumpsymtab(std::ostream&os)const;
+  void dumpdeps(std::ostream&os)const;
 
   // NOTE! Not yet done
 
 private:
+  // (used by AsyncLoader - a vm is compiled by 'prepare(...)', run by the loader and then wrapped in an XConfig object)
+  friend class AsyncLoader;
+  XConfig(std::shared_ptr<Mmvm>vm,std::string const&name,XConfigOptions const&opts);
+  static std::shared_ptr<Mmvm>prepare(std::istream&is,std::string const&name,XConfigOptions const&opts);
+
+  // (used by CompiledConfig - run a program compiled into another vm in a new vm)
+  friend class CompiledConfig;
+  static std::shared_ptr<XConfig>runcompiled(Mmvm const&compiled,std::string const&name,XConfigOptions const&opts);
+
   // compile and run from an input stream
-  void compileAndRun(std::istream&is,std::string const&name);
+  void compileAndRun(std::istream&is,std::string const&name,XConfigOptions const&opts);
 
   // attributes
   std::shared_ptr<xconfig::Mmvm>vm_;
   BasicExtractor basicx_;
+  MemoryStats loadstats_;               // allocations per phase of last load
+  mutable AllocStats extractstats_;     // allocations made by extraction methods
+  mutable std::mutex extractmtx_;       // (only locked if allocations are counted)
 };
 }
@@ -0,0 +1,229 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/codegen.h"
+#include "xconfig/Symtab.h"
+#include "xconfig/EmbeddedProgram.h"
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <set>
+#include <stdexcept>
+#include <type_traits>
+#include <cctype>
+using namespace std;
+namespace xconfig{
+
+// helpers
+namespace{
+// a namespace containing variables and nested namespaces
+struct NsNode{
+  map<string,Mmvm::Value const*>vars;
+  map<string,NsNode>nss;
+};
+// build tree of namespaces from fully qualified variable names
+NsNode buildnstree(map<string,Mmvm::Value>const&vars){
+  NsNode root;
+  for(auto const&[name,value]:vars){
+    NsNode*node=&root;
+    size_t start=0;
+    size_t pos;
+    while((pos=name.find(Symtab::NSSEP,start))!=string::npos){
+      node=&node->nss[name.substr(start,pos-start)];
+      start=pos+1;
+    }
+    node->vars[name.substr(start)]=&value;
+  }
+  return root;
+}
+// C++ type of elements in a list (empty string if elements are both ints and strings)
+// (an empty list is a list of strings)
+string cppelemtype(List const&l){
+  size_t nint=0;
+  for(size_t i=0;i<l.size();++i)nint+=l.isint(i);
+  if(nint==0)return "::std::string_view";
+  return nint==l.size()?"int":"";
+}
+// write a list element as a C++ expression
+void writecppelem(ostream&os,List::Elem const&el){
+  if(holds_alternative<int>(el)){
+    os<<get<int>(el);
+  }else{
+    string sval(get<string_view>(el));
+    os<<"::std::string_view{"<<cppstringliteral(sval)<<","<<sval.size()<<"}";
+  }
+}
+// check that no two names in a namespace map to the same C++ identifier
+// (a renamed keyword or reserved identifier may collide with a name already used in the configuration)
+void checkcppidents(NsNode const&node,string const&path){
+  map<string,string>idents;   // C++ identifier --> name
+  auto add=[&idents,&path](string const&name){
+    auto[it,inserted]=idents.try_emplace(cppident(name),name);
+    if(!inserted&&it->second!=name){
+      throw runtime_error("cannot generate C++ code - '"s+path+it->second+"' and '"+path+name+"' both map to C++ identifier '"+it->first+"'");
+    }
+  };
+  for(auto const&[name,value]:node.vars)add(name);
+  for(auto const&[name,child]:node.nss)add(name);
+}
+// write a namespace node (recursive)
+void writensnode(ostream&os,NsNode const&node,string const&path){
+  checkcppidents(node,path);
+  for(auto const&[name,value]:node.vars){
+    if(node.nss.count(name)){
+      throw runtime_error("cannot generate C++ code - '"s+path+name+"' is both a variable and a namespace");
+    }
+    visit([&os,&name,&path](auto const&v){
+      using V=std::decay_t<decltype(v)>;
+      if constexpr(std::is_same_v<V,std::string>){
+        os<<"inline constexpr ::std::string_view "<<cppident(name)<<"{"<<cppstringliteral(v)<<","<<v.size()<<"};"<<endl;
+      }else if constexpr(std::is_same_v<V,int>){
+        os<<"inline constexpr int "<<cppident(name)<<"="<<v<<";"<<endl;
+      }else if constexpr(std::is_same_v<V,List>){
+        string type=cppelemtype(v);
+        if(type=="")throw runtime_error("cannot generate C++ code - list '"s+path+name+"' contains both ints and strings");
+        os<<"inline constexpr ::std::array<"<<type<<","<<v.size()<<"> "<<cppident(name)<<"{{";
+        for(size_t i=0;i<v.size();++i){
+          if(i)os<<",";
+          writecppelem(os,v[i]);
+        }
+        os<<"}};"<<endl;
+      }else{
+        List vals;
+        for(size_t i=0;i<v.size();++i)vals.push_back(v.value(i));
+        string type=cppelemtype(vals);
+        if(type=="")throw runtime_error("cannot generate C++ code - map '"s+path+name+"' contains both int and string values");
+        os<<"inline constexpr ::std::array<::std::pair<::std::string_view,"<<type<<">,"<<v.size()<<"> "<<cppident(name)<<"{{";
+        for(size_t i=0;i<v.size();++i){
+          if(i)os<<",";
+          os<<"{";
+          writecppelem(os,v.key(i));
+          os<<",";
+          writecppelem(os,v.value(i));
+          os<<"}";
+        }
+        os<<"}};"<<endl;
+      }
+    },*value);
+  }
+  for(auto const&[name,child]:node.nss){
+    os<<"namespace "<<cppident(name)<<"{"<<endl;
+    writensnode(os,child,path+name+Symtab::NSSEP);
+    os<<"}"<<endl;
+  }
+}
+}
+// write a C++ header containing variables as inline constexpr values
+void writecppheader(ostream&os,map<string,Mmvm::Value>const&vars,string const&topns){
+  NsNode root=buildnstree(vars);
+
+  // enclosing namespace may be nested ('a::b') - each part must be an identifier
+  string cppns;
+  for(size_t start=0;topns!="";){
+    size_t pos=topns.find("::",start);
+    string part=topns.substr(start,pos==string::npos?string::npos:pos-start);
+    bool valid=part!=""&&!isdigit(static_cast<unsigned char>(part[0]));
+    for(char c:part)valid=valid&&(isalnum(static_cast<unsigned char>(c))||c=='_');
+    if(!valid)throw runtime_error("cannot generate C++ code - invalid C++ namespace: '"s+topns+"'");
+    cppns+=(cppns==""?"":"::")+cppident(part);
+    if(pos==string::npos)break;
+    start=pos+2;
+  }
+  // declarations may not be added to namespace 'std'
+  if(cppns=="std"||cppns.rfind("std::",0)==0||(cppns==""&&root.nss.count("std"))){
+    throw runtime_error("cannot generate C++ code - variables cannot be placed in namespace 'std' (use an enclosing namespace)");
+  }
+  // header is generated in memory so nothing is written if the configuration cannot be converted
+  ostringstream hdr;
+  hdr<<"// generated by xconfig - do not edit"<<endl;
+  hdr<<"#pragma once"<<endl;
+  hdr<<"#include <string_view>"<<endl;
+  hdr<<"#include <array>"<<endl;
+  hdr<<"#include <utility>"<<endl;
+  if(cppns!="")hdr<<"namespace "<<cppns<<"{"<<endl;
+  writensnode(hdr,root,"");
+  if(cppns!="")hdr<<"}"<<endl;
+  os<<hdr.str();
+}
+// write a C++ source file defining a compiled program as static data
+void writeembeddedprog(ostream&os,Mmvm const&vm,string const&symbol,string const&name){
+  auto const&prog=vm.prog();
+  auto const&stmts=vm.stmts();
+  auto const&lines=vm.lines();
+  os<<"// generated by xconfigc from: "<<name<<" - do not edit"<<endl;
+  os<<"#include \"xconfig/EmbeddedProgram.h\""<<endl;
+  os<<"namespace{"<<endl;
+  os<<"xconfig::EmbeddedElement const elements[]={"<<endl;
+  for(auto const&p:prog){
+    visit([&os](auto const&el){
+      using T=std::decay_t<decltype(el)>;
+      if constexpr(std::is_same_v<T,Mmvm::Opcode>){
+        os<<"  {xconfig::EmbeddedElement::opcode,"<<static_cast<int>(el)<<",nullptr,0},"<<endl;
+      }else if(holds_alternative<string>(el)){
+        string const&str=get<string>(el);
+        os<<"  {xconfig::EmbeddedElement::strval,0,"<<cppstringliteral(str)<<","<<str.size()<<"},"<<endl;
+      }else{
+        os<<"  {xconfig::EmbeddedElement::intval,"<<get<int>(el)<<",nullptr,0},"<<endl;
+      }
+    },p);
+  }
+  // (an empty array is not valid C++)
+  if(prog.empty())os<<"  {xconfig::EmbeddedElement::opcode,0,nullptr,0}"<<endl;
+  os<<"};"<<endl;
+  os<<"xconfig::EmbeddedStmt const stmts[]={"<<endl;
+  for(auto const&stmt:stmts)os<<"  {"<<stmt.begin<<","<<stmt.end<<"},"<<endl;
+  if(stmts.empty())os<<"  {0,0}"<<endl;
+  os<<"};"<<endl;
+  os<<"xconfig::EmbeddedLine const lines[]={"<<endl;
+  for(auto const&line:lines)os<<"  {"<<line.addr<<","<<line.line<<"},"<<endl;
+  if(lines.empty())os<<"  {0,0}"<<endl;
+  os<<"};"<<endl;
+  os<<"}"<<endl;
+  os<<"extern xconfig::EmbeddedProgram const "<<cppident(symbol)<<";"<<endl;
+  os<<"xconfig::EmbeddedProgram const "<<cppident(symbol)<<"{"
+    <<xconfig::EMBEDDED_FORMAT_VERSION<<","<<cppstringliteral(name)<<","<<prog.size()<<",elements,"<<stmts.size()<<",stmts,"<<lines.size()<<",lines};"<<endl;
+}
+// write a C++ header declaring an embedded program
+void writeembeddedheader(ostream&os,string const&symbol){
+  os<<"// generated by xconfigc - do not edit"<<endl;
+  os<<"#pragma once"<<endl;
+  os<<"#include \"xconfig/EmbeddedProgram.h\""<<endl;
+  os<<"extern xconfig::EmbeddedProgram const "<<cppident(symbol)<<";"<<endl;
+}
+// convert a string to a C++ string literal
+// (non printable characters are written as 3 digit octal escapes)
+string cppstringliteral(string const&str){
+  stringstream ret;
+  ret<<'"';
+  for(unsigned char c:str){
+    if(c=='"'||c=='\\')ret<<'\\'<<c;
+    else if(c=='?')ret<<"\\?";                                    // avoid trigraphs
+    else if(c<0x20||c>=0x7f)ret<<'\\'<<oct<<setw(3)<<setfill('0')<<static_cast<int>(c)<<dec;
+    else ret<<c;
+  }
+  ret<<'"';
+  return ret.str();
+}
+// convert an identifier to a valid C++ identifier
+string cppident(string const&name){
+  static set<string>const keywords={
+    "alignas","alignof","and","and_eq","asm","auto","bitand","bitor","bool","break","case","catch","char","char8_t",
+    "char16_t","char32_t","class","compl","concept","const","consteval","constexpr","constinit","const_cast","continue",
+    "co_await","co_return","co_yield","decltype","default","delete","do","double","dynamic_cast","else","enum","explicit",
+    "export","extern","false","float","for","friend","goto","if","inline","int","long","mutable","namespace","new",
+    "noexcept","not","not_eq","nullptr","operator","or","or_eq","private","protected","public","register",
+    "reinterpret_cast","requires","return","short","signed","sizeof","static","static_assert","static_cast","struct",
+    "switch","template","this","thread_local","throw","true","try","typedef","typeid","typename","union","unsigned",
+    "using","virtual","void","volatile","wchar_t","while","xor","xor_eq"};
+  if(keywords.count(name))return name+"_";
+
+  // names reserved to the implementation ('_' followed by an uppercase letter or containing '__') get an 'x' inserted
+  // in front of the leading '_' and between consecutive '_'
+  string ret;
+  for(size_t i=0;i<name.size();++i){
+    if(name[i]=='_'&&((i==0&&name.size()>1&&(isupper(static_cast<unsigned char>(name[1]))||name[1]=='_'))||(i>0&&name[i-1]=='_'))){
+      ret+='x';
+    }
+    ret+=name[i];
+  }
+  return ret;
+}
+}
@@ -0,0 +1,31 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include "xconfig/Mmvm.h"
+#include <string>
+#include <map>
+#include <vector>
+#include <iosfwd>
+namespace xconfig{
+
+// write a C++ header containing variables as inline constexpr values
+// (namespaces in the configuration become nested C++ namespaces, optionally enclosed in namespace 'topns' - 'a' or 'a::b')
+// (int --> 'inline constexpr int', string --> 'inline constexpr std::string_view')
+// (throws std::runtime_error if a name is used both as a variable and as a namespace, if two names map to the same C++
+//  identifier, if 'topns' is not a valid namespace or if variables would be placed in namespace 'std')
+void writecppheader(std::ostream&os,std::map<std::string,Mmvm::Value>const&vars,std::string const&topns);
+
+// write a C++ source file defining a compiled program as static data
+// (defines 'xconfig::EmbeddedProgram const <symbol>' - the program can be run with 'XConfig(<symbol>)')
+void writeembeddedprog(std::ostream&os,Mmvm const&vm,std::string const&symbol,std::string const&name);
+
+// write a C++ header declaring an embedded program
+void writeembeddedheader(std::ostream&os,std::string const&symbol);
+
+// convert a string to a C++ string literal
+std::string cppstringliteral(std::string const&str);
+
+// convert an identifier to a valid C++ identifier
+// (C++ keywords get an '_' appended, reserved identifiers - '_' followed by an uppercase letter or containing '__' -
+//  get an 'x' inserted before the leading '_' and between consecutive '_': '__a__b' --> 'x_x_a_x_b')
+std::string cppident(std::string const&name);
+}
@@ -3,26 +3,41 @@
 #include "parser.hh"
 #include "xconfig/scanner.h"
 #include "xconfig/Mmvm.h"
-#include <iostream>
+#include "xconfig/CodeQueue.h"
 #include <iostream>
 using namespace std;
 using namespace xconfig;
 
 // ctor
 comp_driver::comp_driver(shared_ptr<Mmvm>vm,ostream&os):
-    trace_parsing_(false),trace_scanning_(true),vm_(vm),os_(os),haserror_(false){
+    trace_parsing_(false),trace_scanning_(true),vm_(vm),os_(os),haserror_(false),stmtbegin_(0),
+    codeq_(nullptr),published_(0),publishedstmts_(0),publishedlines_(0),lastlabel_(0),deferrefs_(false){
 }
 // dtor
 comp_driver::~comp_driver(){
 }
 // parse file
-bool comp_driver::parse(istream&is,string const&streamname){
+bool comp_driver::parse(istream&is,string const&streamname,int firstline){
   // create scanner
   haserror_=false;
+  loc_.initialize(nullptr,firstline);
+  symevents_.clear();
   streamname_=streamname;
-  Scanner scanner(&is,&os_);
-  scanner.set_debug(trace_scanning_);
-  lexer_=&scanner;
+  stmtbegin_=vm_->prog().size();
+  published_=stmtbegin_;
+  publishedstmts_=vm_->stmts().size();
+  publishedlines_=vm_->lines().size();
+  codeerr_.reset();
+  fallbacks_.clear();
+  lastlabel_=0;
+  scanstats_=AllocStats{};
+  optional<Scanner>scanner;
+  {
+    AllocScope scope(scanstats_);
+    scanner.emplace(&is,&os_);
+  }
+  scanner->set_debug(trace_scanning_);
+  lexer_=&scanner.value();
 
   // parser
   yy::comp_parser parser(*this);
@@ -62,7 +77,141 @@ shared_ptr<xconfig::Mmvm>comp_driver::vm(){return vm_;}
 // get pointer to lexer object
 Scanner*comp_driver::lexer()noexcept{return lexer_;}
 
+// get next token from lexer
+yy::comp_parser::symbol_type comp_driver::lex(){
+  AllocScope scope(scanstats_);
+  return lexer_->lex(*this);
+}
+AllocStats const&comp_driver::scanstats()const noexcept{return scanstats_;}
+
 // get symtab ref
 xconfig::Symtab&comp_driver::symtab(){
   return symtab_;
 }
+// push/pop namespace
+void comp_driver::pushns(string const&name){
+  symtab_.pushns(name);
+  if(deferrefs_)symevents_.push_back(SymEvent{SymEvent::pushns,name,0});
+}
+void comp_driver::popns(){
+  symtab_.popns();
+  if(deferrefs_)symevents_.push_back(SymEvent{SymEvent::popns,"",0});
+}
+// add symbol to current namespace - returns fully qualified name
+string comp_driver::addsym(string const&name){
+  if(deferrefs_)symevents_.push_back(SymEvent{SymEvent::def,name,0});
+  return symtab_.addsym(name);
+}
+// generate code pushing a variable
+bool comp_driver::codevar(string const&name){
+  auto sym=symtab_.lookupsym(name);
+  if(!sym&&!deferrefs_)return false;
+  size_t addr=vm_->code(Mmvm::Opcode::push_var,sym?sym.value():""s);
+
+  // (a symbol found in the current namespace cannot be shadowed by symbols defined elsewhere - no need to record it)
+  if(deferrefs_&&(!sym||sym.value()!=symtab_.fullyQualifiedName(name)))symevents_.push_back(SymEvent{SymEvent::ref,name,addr+1});
+  return true;
+}
+// record symbol events instead of reporting unknown symbols
+void comp_driver::deferrefs(bool defer){deferrefs_=defer;}
+vector<comp_driver::SymEvent>comp_driver::takesymevents(){return std::move(symevents_);}
+
+// mark end of a statement
+void comp_driver::endstmt(yy::location const&l){
+  size_t end=vm_->prog().size();
+  vm_->addline(stmtbegin_,l.begin.line);
+  vm_->addstmt(stmtbegin_,end);
+  stmtbegin_=end;
+  publish(false);
+}
+// mark end of code not belonging to a statement
+void comp_driver::endnonstmt(yy::location const&l){
+  if(vm_->prog().size()>stmtbegin_)vm_->addline(stmtbegin_,l.begin.line);
+  stmtbegin_=vm_->prog().size();
+  publish(false);
+}
+// mark end of program
+void comp_driver::endprog(){
+  publish(true);
+}
+// both operands of an addition have been compiled
+// (additions are right associative - if the right operand ends with an addition it is extended to also add the left operand
+//  unless a jump targets the end of the right operand since the value on the stack is then not always the sum)
+void comp_driver::codeadd(){
+  auto const&prog=vm_->prog();
+  size_t size=prog.size();
+  auto isop=[&prog](size_t addr,Mmvm::Opcode op){
+    return holds_alternative<Mmvm::Opcode>(prog[addr])&&get<Mmvm::Opcode>(prog[addr])==op;
+  };
+  if(size>0&&size!=lastlabel_){
+    if(size>=2&&isop(size-2,Mmvm::Opcode::concat)){
+      vm_->patchcode(size-1,Mmvm::Value(get<int>(get<Mmvm::Value>(prog[size-1]))+1));
+      return;
+    }
+    if(isop(size-1,Mmvm::Opcode::add_stack)){
+      vm_->patchcode(size-1,Mmvm::Opcode::concat);
+      vm_->code(Mmvm::Value(3));
+      return;
+    }
+  }
+  vm_->code(Mmvm::Opcode::add_stack);
+}
+// left operand of a fallback has been compiled
+// (an environment variable as left operand is allowed to be unset - it then falls back to the right operand)
+void comp_driver::beginfallback(){
+  auto const&prog=vm_->prog();
+  size_t size=prog.size();
+  if(size>=2&&holds_alternative<Mmvm::Opcode>(prog[size-2])&&get<Mmvm::Opcode>(prog[size-2])==Mmvm::Opcode::push_env){
+    vm_->patchcode(size-2,Mmvm::Opcode::push_env_opt);
+  }
+  fallbacks_.push_back(vm_->code(Mmvm::Opcode::jmp_nonempty,0));
+}
+// right operand of a fallback has been compiled - jump from left operand to here
+// (jump offset is relative so that code of a statement does not depend on where it is located)
+void comp_driver::endfallback(){
+  size_t jaddr=fallbacks_.back();
+  fallbacks_.pop_back();
+  vm_->patchcode(jaddr+1,Mmvm::Value(static_cast<int>(vm_->prog().size()-jaddr)));
+  lastlabel_=vm_->prog().size();
+}
+// set queue receiving validated code
+void comp_driver::setcodequeue(CodeQueue*queue){
+  codeq_=queue;
+}
+// get error from validating code passed to queue
+optional<MmvmError>const&comp_driver::codeerror()const noexcept{
+  return codeerr_;
+}
+// validate code generated since last call and pass it to queue
+// (small blocks are held back to keep locking cheap unless they execute commands - commands should start as early as possible)
+void comp_driver::publish(bool force){
+  if(!codeq_||codeerr_)return;
+  auto const&prog=vm_->prog();
+  auto const&stmts=vm_->stmts();
+  if(published_==prog.size())return;
+  if(!force&&prog.size()-published_<MINBLOCKSIZE){
+    bool hascmd=false;
+    for(size_t i=published_;i<prog.size()&&!hascmd;++i){
+      if(!holds_alternative<Mmvm::Opcode>(prog[i]))continue;
+      Mmvm::Opcode op=get<Mmvm::Opcode>(prog[i]);
+      hascmd=op==Mmvm::Opcode::shell||op==Mmvm::Opcode::interp;
+    }
+    if(!hascmd)return;
+  }
+  size_t maxdepth;
+  auto vmerr=vm_->validatecode(published_,prog.size(),&maxdepth);
+  if(!vmerr){
+    codeerr_=vmerr;
+    codeq_->close();
+    return;
+  }
+  CodeBlock block;
+  block.code.assign(prog.begin()+published_,prog.end());
+  block.stmts.assign(stmts.begin()+publishedstmts_,stmts.end());
+  block.lines.assign(vm_->lines().begin()+publishedlines_,vm_->lines().end());
+  block.maxdepth=maxdepth;
+  published_=prog.size();
+  publishedstmts_=stmts.size();
+  publishedlines_=vm_->lines().size();
+  codeq_->push(std::move(block));
+}
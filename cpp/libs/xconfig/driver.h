@@ -2,11 +2,15 @@
 #pragma once
 #include "parser.hh"   // needed for 'yy::location'
 #include "xconfig/Symtab.h"
+#include "xconfig/MmvmError.h"
+#include "xconfig/MemStats.h"
 #include <string>
 #include <memory>
+#include <optional>
+#include <vector>
 
 // forward decl
-namespace xconfig{class Mmvm;}
+namespace xconfig{class Mmvm;class CodeQueue;}
 class Scanner;
 
 // Conducting the whole scanning and parsing of comp.
@@ -20,9 +24,17 @@ public:
   comp_driver&operator=(comp_driver&&)=delete;
   virtual~comp_driver();
 
+  // symbol events recorded when compiling a block of a configuration separately from the blocks preceding it
+  // (events are replayed in source order against the symbols of the complete configuration - see 'deferrefs(...)')
+  struct SymEvent{
+    enum Kind{pushns=0,popns=1,def=2,ref=3};
+    Kind kind;
+    std::string name;                   // namespace, defined symbol or referenced (non-qualified) symbol
+    std::size_t addr;                   // address of 'push_var' operand naming the referenced symbol (ref only)
+  };
   // parse file
-  // (return true on success)
-  bool parse(std::istream&is,const std::string&streamname);
+  // (return true on success - 'firstline' is the source line of the first character in the stream)
+  bool parse(std::istream&is,const std::string&streamname,int firstline=1);
 
   // tracing related functions
   // (getters/setters)
@@ -49,9 +61,53 @@ public:
   // get pointer to lexer object
   Scanner*lexer()noexcept;
 
+  // get next token from lexer
+  // (allocations made while scanning - including creating the scanner - are added to 'scanstats()')
+  yy::comp_parser::symbol_type lex();
+  xconfig::AllocStats const&scanstats()const noexcept;
+
   // get symtab ref
   xconfig::Symtab&symtab();
+
+  // symbol management (called by parser)
+  // ('codevar(...)' generates code pushing a variable - returns false if the symbol does not exist)
+  void pushns(std::string const&name);
+  void popns();
+  std::string addsym(std::string const&name);
+  bool codevar(std::string const&name);
+
+  // record symbol events instead of reporting references to symbols that do not exist
+  // (a reference to an unknown symbol is coded with an empty name as operand - references to symbols in the current
+  //  namespace are not recorded)
+  void deferrefs(bool defer);
+  std::vector<SymEvent>takesymevents();
+
+  // mark end of a statement / end of code not belonging to a statement
+  // (statements and the source line their code was compiled from are recorded in the vm)
+  void endstmt(yy::location const&l);
+  void endnonstmt(yy::location const&l);
+  void endprog();
+
+  // generate code adding the two top values on the stack
+  // (a chain of additions is compiled into a single 'concat' instruction)
+  void codeadd();
+
+  // generate code for 'left ?? right' (called after left and right operands have been compiled)
+  // (a jump over the right operand is patched when the right operand ends)
+  void beginfallback();
+  void endfallback();
+
+  // pass validated code to a queue at each statement boundary (pipelined compilation and execution)
+  // (if validation fails the queue is closed and the error is returned by 'codeerror()')
+  void setcodequeue(xconfig::CodeQueue*queue);
+  std::optional<xconfig::MmvmError>const&codeerror()const noexcept;
 private:
+  // min #of program elements passed to queue in one block
+  constexpr static std::size_t MINBLOCKSIZE=256;
+
+  // helper methods
+  void publish(bool force);
+
   // whether parser traces should be generated
   bool trace_parsing_;
   bool trace_scanning_;
@@ -62,4 +118,15 @@ private:
   std::ostream&os_;
   bool haserror_;
   yy::location loc_;
+  std::size_t stmtbegin_;
+  xconfig::CodeQueue*codeq_;
+  std::size_t published_;               // end of code passed to queue
+  std::size_t publishedstmts_;          // #of statements passed to queue
+  std::size_t publishedlines_;          // #of line table entries passed to queue
+  std::optional<xconfig::MmvmError>codeerr_;
+  std::vector<std::size_t>fallbacks_;   // addresses of unpatched fallback jumps
+  std::size_t lastlabel_;               // last address targeted by a jump
+  xconfig::AllocStats scanstats_;       // allocations made while scanning
+  bool deferrefs_;                      // record symbol events instead of reporting unknown symbols
+  std::vector<SymEvent>symevents_;
 };
@@ -0,0 +1,269 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#include "xconfig/parcompile.h"
+#include "xconfig/driver.h"
+#include "xconfig/CodeQueue.h"
+#include "xconfig/ThreadPool.h"
+#include "xconfig/Symtab.h"
+#include <streambuf>
+#include <istream>
+#include <sstream>
+#include <string_view>
+#include <future>
+#include <thread>
+#include <algorithm>
+#include <unordered_map>
+#include <exception>
+using namespace std;
+namespace xconfig{
+
+// helpers
+namespace{
+// min #of characters in a block and #of blocks per thread (more blocks than threads evens out load)
+constexpr size_t MINBLOCKSIZE=1<<16;
+constexpr size_t BLOCKSPERTHREAD=4;
+
+// read characters of a block directly from the source text (no copy)
+class BlockBuf:public streambuf{
+public:
+  BlockBuf(char const*begin,char const*end){
+    char*b=const_cast<char*>(begin);
+    setg(b,b,const_cast<char*>(end));
+  }
+};
+// result of compiling a block
+struct CompiledBlock{
+  shared_ptr<Mmvm>vm;
+  Symtab symtab;                        // symbols defined by block
+  vector<string>topnames;               // first component of symbols defined by block
+  vector<comp_driver::SymEvent>events;
+  AllocStats scanstats;
+  AllocStats parsestats;                // includes allocations made while scanning, validating and resolving symbols
+  bool ok=false;
+};
+// blocks defining symbols starting with a top level name (blocks in source order)
+using Owners=unordered_map<string,vector<size_t>>;
+
+// compile a block into a separate vm
+// (errors are not reported - the source is compiled sequentially if any block fails)
+void compileblock(string const&src,string const&name,SourceBlock const&block,CompiledBlock&res){
+  try{
+    AllocScope scope(res.parsestats);
+    res.vm=make_shared<Mmvm>();
+    stringstream errstr;
+    comp_driver driver(res.vm,errstr);
+    driver.trace_scanning(false);
+    driver.trace_parsing(false);
+    driver.deferrefs(true);
+    BlockBuf buf(src.data()+block.begin,src.data()+block.end);
+    istream is(&buf);
+    res.ok=driver.parse(is,name,block.firstline);
+    res.scanstats=driver.scanstats();
+    res.events=driver.takesymevents();
+    res.symtab=std::move(driver.symtab());
+    for(auto const&sym:res.symtab.syms()){
+      string_view top(sym.data(),min(sym.find(Symtab::NSSEP),sym.size()));
+      if(res.topnames.empty()||res.topnames.back()!=top)res.topnames.emplace_back(top);
+    }
+  }
+  catch(exception const&){
+    res.ok=false;
+  }
+}
+// resolve symbols referenced by a block that were not found when the block was compiled and verify the code of the block
+// (returns false if the block defines a symbol already defined by a preceding block or references a symbol that does not
+//  exist - lookups are done exactly as the sequential compiler does them, with symbols of preceding blocks defined)
+// (code is verified after it has been patched since patching clears the verified mark)
+bool resolveblock(vector<CompiledBlock>&blocks,size_t ind,Owners const&owners){
+  CompiledBlock&block=blocks[ind];
+  AllocScope scope(block.parsestats);
+  auto defined=[&](string const&fqname){
+    auto it=owners.find(fqname.substr(0,fqname.find(Symtab::NSSEP)));
+    if(it==owners.end())return false;
+    for(size_t i:it->second){
+      if(i>=ind)break;
+      if(blocks[i].symtab.hassym(fqname))return true;
+    }
+    return false;
+  };
+  Symtab nstab;                         // tracks namespaces while events are replayed
+  for(auto const&ev:block.events){
+    switch(ev.kind){
+    case comp_driver::SymEvent::pushns:
+      nstab.pushns(ev.name);
+      break;
+    case comp_driver::SymEvent::popns:
+      nstab.popns();
+      break;
+    case comp_driver::SymEvent::def:
+      if(nstab.lookupsym(nstab.fullyQualifiedName(ev.name),defined))return false;
+      break;
+    case comp_driver::SymEvent::ref:{
+      string const&local=get<string>(get<Mmvm::Value>(block.vm->prog()[ev.addr]));
+      auto sym=nstab.lookupsym(ev.name,[&](string const&fqname){return fqname==local||defined(fqname);});
+      if(!sym)return false;
+      if(sym.value()!=local)block.vm->patchcode(ev.addr,Mmvm::Value(sym.value()));
+      break;
+    }
+    }
+  }
+  return static_cast<bool>(block.vm->verifycode());
+}
+// run 'f(i)' for each block on a thread pool - returns false if 'f' returned false for any block
+template<typename F>
+bool foreachblock(ThreadPool&pool,size_t nblocks,F f){
+  vector<future<bool>>futs;
+  for(size_t i=0;i<nblocks;++i)futs.push_back(pool.submit([&f,i](){return f(i);}));
+  bool ret=true;
+  for(auto&fut:futs)ret=fut.get()&&ret;
+  return ret;
+}
+}
+// split source text into blocks after the '}' closing top level namespaces
+// (tokens that may contain braces, newlines or '#' - strings, commands, comments and '{name}' identifiers - are skipped the
+//  same way the scanner matches them, lines are counted the same way the scanner counts them)
+vector<SourceBlock>splitsource(string const&src,size_t minsize){
+  vector<SourceBlock>ret;
+  vector<SourceBlock>const whole{SourceBlock{0,src.size(),1}};
+  size_t n=src.size();
+  size_t begin=0;
+  int line=1;
+  int firstline=1;
+  int depth=0;                          // nesting of braces
+  bool nsblock=false;                   // true if the outermost open brace starts a namespace
+  int nsstate=0;                        // tokens just seen at top level: 1 - 'namespace', 2 - 'namespace' <identifier>
+  auto isidstart=[](char c){return (c>='a'&&c<='z')||(c>='A'&&c<='Z');};
+  auto isidc=[&](char c){return isidstart(c)||(c>='0'&&c<='9')||c=='_'||c=='.';};
+  auto isenvc=[&](char c){return isidstart(c)||(c>='0'&&c<='9')||c=='_';};
+
+  // position after a string/command starting at 'i' (npos if not terminated - '\' cannot escape a newline)
+  auto skipquoted=[&](size_t i,char quote){
+    for(++i;i<n;++i){
+      if(src[i]==quote)return i+1;
+      if(src[i]=='\\'){
+        if(i+1==n||src[i+1]=='\n')return string::npos;
+        ++i;
+      }
+    }
+    return string::npos;
+  };
+  // length of a '{name}' starting at 'i' (0 if there is none)
+  auto bracedname=[&](size_t i,bool allowdot)->size_t{
+    if(i+1>=n||src[i]!='{'||!isidstart(src[i+1]))return 0;
+    size_t j=i+2;
+    while(j<n&&(allowdot?isidc(src[j]):isenvc(src[j])))++j;
+    return j<n&&src[j]=='}'?j+1-i:0;
+  };
+  size_t i=0;
+  while(i<n){
+    char c=src[i];
+    if(c==' '||c=='\t'||c=='\r'){
+      ++i;
+    }else if(c=='#'){
+      while(i<n&&src[i]!='\n')++i;
+    }else if(c=='\n'){
+      ++line;++i;
+      nsstate=0;
+    }else if(c=='"'||c=='`'){
+      size_t end=skipquoted(i,c);
+      if(end==string::npos&&c=='"')return whole;
+      i=end==string::npos?i+1:end;      // a '`' without a matching '`' is a token by itself
+      nsstate=0;
+    }else if(c=='$'){
+      size_t len=bracedname(i+1,false);
+      for(++i;!len&&i<n&&isenvc(src[i]);)++i;
+      i+=len;
+      nsstate=0;
+    }else if(isidstart(c)||(c=='%'&&i+1<n&&isidstart(src[i+1]))){
+      size_t start=c=='%'?i+1:i;
+      size_t end=start;
+      while(end<n&&isidc(src[end]))++end;
+      string_view id(src.data()+start,end-start);
+      nsstate=c!='%'&&id=="namespace"?1:(nsstate==1?2:0);   // ('cache' is an identifier after 'namespace')
+      i=end;
+    }else if(c=='{'||(c=='%'&&bracedname(i+1,true))){
+      size_t len=c=='%'?1+bracedname(i+1,true):bracedname(i,true);
+      if(len){
+        i+=len;
+        nsstate=nsstate==1?2:0;
+      }else{
+        if(depth==0)nsblock=nsstate==2;
+        ++depth;++i;
+        nsstate=0;
+      }
+    }else if(c=='}'){
+      if(depth==0)return whole;
+      ++i;
+      nsstate=0;
+      if(--depth==0&&nsblock&&i-begin>=minsize){
+        ret.push_back(SourceBlock{begin,i,firstline});
+        begin=i;
+        firstline=line;
+      }
+    }else{
+      ++i;
+      nsstate=0;
+    }
+  }
+  if(begin<n||ret.empty())ret.push_back(SourceBlock{begin,n,firstline});
+  return ret;
+}
+// compile source text into a vm, compiling blocks of the source in parallel
+bool compileparallel(shared_ptr<Mmvm>vm,string const&src,string const&name,size_t nthreads,MemoryStats*memstats){
+  if(nthreads==0)nthreads=max(1u,thread::hardware_concurrency());
+  auto blocks=splitsource(src,max(MINBLOCKSIZE,src.size()/(nthreads*BLOCKSPERTHREAD)));
+  if(blocks.size()<2)return false;
+
+  // scan and parse blocks
+  ThreadPool pool(min(nthreads,blocks.size()));
+  vector<CompiledBlock>compiled(blocks.size());
+  bool ok=foreachblock(pool,blocks.size(),[&](size_t i){
+    compileblock(src,name,blocks[i],compiled[i]);
+    return compiled[i].ok;
+  });
+  if(!ok)return false;
+
+  // resolve symbols against symbols defined by preceding blocks and verify code
+  Owners owners;
+  for(size_t i=0;i<compiled.size();++i){
+    for(auto const&top:compiled[i].topnames)owners[top].push_back(i);
+  }
+  ok=foreachblock(pool,compiled.size(),[&](size_t i){
+    return resolveblock(compiled,i,owners);
+  });
+  if(!ok)return false;
+
+  // merge code in source order
+  // ('stop' ending the program of each block except the last one is dropped)
+  AllocStats mergestats;
+  {
+    AllocScope scope(mergestats);
+    vector<CodeBlock>code;
+    for(size_t i=0;i<compiled.size();++i){
+      code.push_back(compiled[i].vm->takecode());
+      if(i+1<compiled.size())code.back().code.pop_back();
+      compiled[i].vm.reset();
+    }
+    vm->appendcode(std::move(code),&pool);
+  }
+  // allocations made by all blocks (merging is counted as parsing)
+  if(memstats){
+    AllocStats scanstats;
+    AllocStats parsestats=mergestats;
+    for(auto const&block:compiled){
+      scanstats+=block.scanstats;
+      parsestats+=block.parsestats;
+    }
+    parsestats-=scanstats;
+    memstats->phases["scan"]=scanstats;
+    memstats->phases["parse"]=parsestats;
+    SizeStats symtabsize;
+    for(auto const&block:compiled){
+      auto size=block.symtab.memusage();
+      symtabsize.nelems+=size.nelems;
+      symtabsize.bytes+=size.bytes;
+    }
+    memstats->structs["symtab-compile"]=symtabsize;
+  }
+  return true;
+}
+}
@@ -0,0 +1,29 @@
+// (C) Copyright Hans Ewetz 2018. All rights reserved.
+#pragma once
+#include "xconfig/Mmvm.h"
+#include "xconfig/MemStats.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+namespace xconfig{
+
+// block of source text ending at a top level namespace boundary
+struct SourceBlock{
+  std::size_t begin;                    // offset of first character
+  std::size_t end;                      // offset after last character
+  int firstline;                        // source line of first character
+};
+// split source text into blocks after the '}' closing top level namespaces
+// (consecutive namespaces are joined into blocks of at least 'minsize' characters - returns a single block if the source
+//  cannot be split, e.g. because a string is not terminated)
+std::vector<SourceBlock>splitsource(std::string const&src,std::size_t minsize);
+
+// compile source text into a vm, compiling blocks of the source on 'nthreads' threads (0: one thread per core)
+// (blocks are scanned, parsed and validated concurrently - code is merged in source order after symbol references have
+//  been resolved against symbols defined by preceding blocks)
+// (returns false without modifying the vm if the source could not be split or if compiling fails - the source must then
+//  be compiled sequentially, which also reports errors exactly as when the source is not split)
+bool compileparallel(std::shared_ptr<Mmvm>vm,std::string const&src,std::string const&name,std::size_t nthreads,
+                     MemoryStats*memstats=nullptr);
+}
@@ -47,8 +47,9 @@ using op=xconfig::Mmvm::Opcode;
 #define symtab driver.symtab()
 
 // connect bison parser --> flex scanner via driver
+// (driver counts allocations made while scanning)
 #undef yylex
-#define yylex driver.lexer()->lex
+#define yylex(d) (d).lex()
 
 // access to vm
 // (makes code generation less noisy)
@@ -71,7 +72,13 @@ using op=xconfig::Mmvm::Opcode;
   AT      "at sign"
   LB      "left brace"
   RB      "right brace"
+  LBRACKET "left bracket"
+  RBRACKET "right bracket"
+  COMMA   "comma"
+  COLON   "colon"
   NAMESPACE      "namespace"
+  CACHE          "cache"
+  FALLBACK       "fallback"
 ;
 
 // semantic values are c++ objects (i.e. variant based)
@@ -82,27 +89,39 @@ using op=xconfig::Mmvm::Opcode;
 %token <std::string> ENV "environment-variable"
 %token <int> NUMBER "number"
 
+// operator precedence (lowest first)
+// (assignments, '@' and 'cache N' extend as far to the right as possible, '+' and '??' have the same precedence and
+//  group to the right - 'a + b ?? c' is 'a + (b ?? c)', 'a ?? b + c' is 'a ?? (b + c)', 'cache N x ?? y' is 'cache N (x ?? y)')
+%right ASSIGN AT CACHE
+%right PLUS FALLBACK
+
+// #of elements in list and map literals
+%type <int> items mapitems
+
+// identifiers ('cache' is only a keyword when followed by a number)
+%type <std::string> ident
+
 // grammar
 %%
-prog: stmts              {vm.code(op::stop);}
+prog: stmts              {vm.code(op::stop);driver.endprog();}
     ;
 stmts:
     | stmts stmt
     ;
 stmt: SEP
-    | expr SEP            {vm.code(op::pop_stack);}
-    | nsdecl LB stmts RB  {symtab.popns();vm.code(op::pop_ns);}
+    | expr SEP            {vm.code(op::pop_stack);driver.endstmt(@1);}
+    | nsdecl LB stmts RB  {driver.popns();vm.code(op::pop_ns);driver.endnonstmt(@4);}
     ;
-nsdecl: NAMESPACE IDENT   {if(!symtab.isSimpleSymbol($2)){
+nsdecl: NAMESPACE ident   {if(!symtab.isSimpleSymbol($2)){
                              error(loc,"invalid namespace identifier: '"s+$2+"' (contains '.')");
                              YYERROR;
                            }
-                           symtab.pushns($2);vm.code(op::push_ns,$2);}
+                           driver.pushns($2);vm.code(op::push_ns,$2);driver.endnonstmt(@1);}
     ;
 expr: value
-    | expr PLUS expr      {vm.code(op::add_stack);}
+    | expr PLUS expr      {driver.codeadd();}
     | BS expr BS          {vm.code(op::shell);}
-    | IDENT ASSIGN expr   {if(!symtab.isSimpleSymbol($1)){
+    | ident ASSIGN expr   {if(!symtab.isSimpleSymbol($1)){
                              error(loc,"cannot assign to namespace qualified symbol: '"s+$1+"'");
                              YYERROR;
                            }
@@ -110,24 +129,44 @@ expr: value
                              error(loc,"symbol: '"s+$1+"' already exist in current namespace");
                              YYERROR;
                            }
-                           auto sym=symtab.addsym($1);
+                           auto sym=driver.addsym($1);
                            vm.code(op::add_sym,$1);        // code non-qualified name in symbol table
                            vm.code(op::store_stack,sym);   // code fully qualified name as memory address
                           }
     | ENV ASSIGN expr     {vm.code(op::set_env,$1);}       // will store top of stack in environment variable $1
     | AT expr             {vm.code(op::interp);}
+    | CACHE NUMBER        {vm.code(op::push_ttl,$2);}    // cache output of commands in expr for $2 seconds
+      expr %prec CACHE    {vm.code(op::pop_ttl);}
+    | expr FALLBACK       {driver.beginfallback();}       // right expr is only evaluated if left expr is an empty string
+      expr                {driver.endfallback();}
     | LP expr RP 
+    | LBRACKET RBRACKET          {vm.code(op::make_list,0);}
+    | LBRACKET items RBRACKET    {vm.code(op::make_list,$2);}
+    | LB RB                      {vm.code(op::make_map,0);}
+    | LB mapitems RB             {vm.code(op::make_map,$2);}
     ;
+items: expr                      {$$=1;}
+     | items COMMA expr          {$$=$1+1;}
+     ;
+mapitems: mapitem                {$$=1;}
+        | mapitems COMMA mapitem {$$=$1+1;}
+        ;
+mapitem: mapkey COLON expr
+       ;
+mapkey: ident                    {vm.code(op::push_const,$1);}
+      | QSTRING                  {vm.code(op::push_const,$1);}
+      ;
 value: NUMBER  {vm.code(op::push_const,$1);}
      | QSTRING {vm.code(op::push_const,$1);}
      | ESTRING {vm.code(op::push_const,$1);vm.code(op::shell);}
      | ENV     {vm.code(op::push_env,$1);}
-     | IDENT   {auto sym=symtab.lookupsym($1);
-                if(!sym.has_value()){
+     | ident   {if(!driver.codevar($1)){
                   error(loc,"no such symbol in current or enclosing namespaces: '"s+$1+"'");
                   YYERROR;
-                }
-                vm.code(op::push_var,sym.value());}
+                }}
+     ;
+ident: IDENT
+     | CACHE   {$$="cache"s;}
      ;
 %%
 
@@ -4,8 +4,13 @@
 #include <vector>
 #include <iostream>
 #include <cstring>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <limits>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
 #include <sys/prctl.h>
 #include <sys/types.h>
@@ -43,43 +48,64 @@ optional<string>parseexitstat(int stat){
     return msg;
   }
 }
+// convert exit status + output from child into a result
+pair<bool,string>exitstat2result(int stat,string&out){
+  // get exit status
+  auto exitstaterr=parseexitstat(stat);
+  if(exitstaterr)return pair(false,exitstaterr.value());
+
+  // no errors
+  if(out.length()&&out[out.length()-1]=='\n')out.pop_back();
+  return pair(true,move(out));
+}
+// helpers
+namespace{
 // spawn child process setting up stdout and stdin as a pipe
-optional<string>spawnpipchld(string const&file,vector<string>args,int&fdread,int&fdwrite,int&cpid,bool diewhenparentdies){
+// (if 'envp' is null the child inherits the process environment)
+optional<string>spawnchld(string const&file,vector<string>const&args,vector<string>const*envp,int&fdread,int&fdwrite,int&cpid,bool diewhenparentdies,bool newpgrp){
+  // setup arguments for calling execv before forking
+  // (no memory allocations are made in child since the parent may be multi-threaded)
+  vector<char*>tmpargs;
+  for(auto const&arg:args)tmpargs.push_back(const_cast<char*>(arg.c_str()));
+  tmpargs.push_back(nullptr);
+  vector<char*>tmpenv;
+  if(envp){
+    for(auto const&e:*envp)tmpenv.push_back(const_cast<char*>(e.c_str()));
+    tmpenv.push_back(nullptr);
+  }
   // create pipe between child and parent
+  // (close-on-exec so pipes are not leaked into children spawned concurrently from other threads)
   int fromChild[2];
   int toChild[2];
-  if(pipe(toChild)!=0||pipe(fromChild)!=0)return "failed creating pipe: "s+strerror(errno);
-
+  if(pipe2(toChild,O_CLOEXEC)!=0)return "failed creating pipe: "s+strerror(errno);
+  if(pipe2(fromChild,O_CLOEXEC)!=0){
+    string err="failed creating pipe: "s+strerror(errno);
+    eclose(toChild[0]);eclose(toChild[1]);
+    return err;
+  }
   // fork child process
   int pid=fork();
   if(pid==0){ // child
     // die if parent dies so we won't become a zombie
 // NOTE! should be able to select signal ... (?)
-    if(diewhenparentdies&&prctl(PR_SET_PDEATHSIG,SIGHUP)<0)return "failed call to prctl(...): "s+strerror(errno);
+    if(diewhenparentdies&&prctl(PR_SET_PDEATHSIG,SIGHUP)<0)_exit(127);
 
-    // dup stdin/stdout ---> pipe, and close original pipe fds
-    eclose(0);eclose(1);                            // NOTE! Must check for errors
-    dup(toChild[0]);dup(fromChild[1]);
-    eclose(toChild[1]);eclose(fromChild[0]);
-    eclose(toChild[0]);eclose(fromChild[1]);
+    // make child leader of a new process group so the child and its descendants can be killed together
+    if(newpgrp&&setpgid(0,0)<0)_exit(127);
 
-    // setup for calling execv 
-    // (we don't care if we leak memory since we'll overlay process using exec)
-    char*const*tmpargs=(char*const*)malloc((args.size()+1)*sizeof(char*const*));
-    if(tmpargs==0)return "failed call to malloc(...): "s+strerror(errno);
+    // dup stdin/stdout ---> pipe
+    // (original pipe fds are closed on exec)
+    if(dup2(toChild[0],0)<0||dup2(fromChild[1],1)<0)_exit(127);
 
-    char**ptmpargs=const_cast<char**>(tmpargs);
-    for(std::size_t i=0;i<args.size();++i)ptmpargs[i]=const_cast<char*>(args[i].c_str());
-    ptmpargs[args.size()]=0;
-    // execute child process
-    if(execvp(file.c_str(),tmpargs)<0){
-      return "failed executing execl: "s+strerror(errno);
-    }else{
-      // should never get here
-      return "failed executing execl: "s+strerror(errno);
-    }
+    // execute child process - only returns on failure
+    if(envp)execvpe(file.c_str(),tmpargs.data(),tmpenv.data());
+    else execvp(file.c_str(),tmpargs.data());
+    _exit(127);
   }else
   if(pid>0){ // parent
+    // set process group also from parent so there is no window where the child is not in its group
+    if(newpgrp)setpgid(pid,pid);
+
     // close fds we don't use
     eclose(fromChild[1]);eclose(toChild[0]);
 
@@ -90,37 +116,160 @@ optional<string>spawnpipchld(string const&file,vector<string>args,int&fdread,int
     return nullopt;
   }else{
     // fork failed
-    return "failed fork: "s+strerror(errno);
+    string err="failed fork: "s+strerror(errno);
+    eclose(fromChild[0]);eclose(fromChild[1]);
+    eclose(toChild[0]);eclose(toChild[1]);
+    return err;
   }
-  return nullopt;
 }
-// execute a program and capture output into a string
-// (of ret.first == true, output is in res->second, elase error is in ret->second)
-pair<bool,string>execprog(string file,vector<string>args){
-  int fdread;
-  int fdwrite;
-  int cpid;
-  auto res=spawnpipchld(file,args,fdread,fdwrite,cpid,true);
-  if(res)return pair(false,res.value());
+// read output from child, wait for child and get output into a string
+// (if deadline passes, the process group of the child is killed)
+pair<bool,string>collectchld(int fdread,int fdwrite,int cpid,optional<chrono::steady_clock::time_point>const&deadline,bool&timedout){
+  timedout=false;
 
   // read data from pipe ...
   eclose(fdwrite);
-  stringstream str;
-  char c;
-  while(read(fdread,&c,1)==1)str<<c;    // NOTE! should handle error here
+  string ret;
+  char buf[4096];
+  while(true){
+    if(deadline){
+      pollfd pfd{fdread,POLLIN,0};
+      int stat=poll(&pfd,1,msleft(deadline));
+      if(stat<0&&errno==EINTR)continue;
+      if(stat==0){timedout=true;break;}
+    }
+    ssize_t nread=read(fdread,buf,sizeof(buf));
+    if(nread<0&&errno==EINTR)continue;
+    if(nread<=0)break;                  // NOTE! should handle error here
+    ret.append(buf,nread);
+  }
   eclose(fdread);
 
   // wait for child and get exit status code
+  // (if we have a deadline we poll for child termination until deadline passes)
   int stat;
+  if(deadline&&!timedout){
+    int pid;
+    chrono::microseconds backoff(50);
+    while((pid=waitpid(cpid,&stat,WNOHANG))==0&&msleft(deadline)>0){
+      this_thread::sleep_for(backoff);
+      backoff=min(2*backoff,chrono::microseconds(10000));
+    }
+    if(pid==cpid)return exitstat2result(stat,ret);
+    if(pid<0)return pair(false,"failed waiting for child process, err: "s+strerror(errno));
+    timedout=true;
+  }
+  if(timedout){
+    kill(-cpid,SIGKILL);
+    waitpid(cpid,&stat,0);
+    return pair(false,"child process killed after deadline passed"s);
+  }
   if(waitpid(cpid,&stat,0)!=cpid)return pair(false,"failed waiting for child process, err: "s+strerror(errno));
-
-  // get exit status
-  auto exitstaterr=parseexitstat(stat);
-  if(exitstaterr)return pair(false,exitstaterr.value());
-
-  // no errors
-  string ret=str.str();
-  if(ret.length()&&ret[ret.length()-1]=='\n')ret=ret.substr(0,ret.length()-1);
-  return pair(true,ret);
+  return exitstat2result(stat,ret);
+}
+// limit on #of concurrently executing child processes
+class ChildSlots{
+public:
+  // acquire a slot - returns false if deadline passes before a slot is available
+  bool acquire(optional<chrono::steady_clock::time_point>const&deadline){
+    unique_lock<mutex>lock(mtx_);
+    auto avail=[this](){return max_==0||nrunning_<max_;};
+    if(deadline){
+      if(!cond_.wait_until(lock,deadline.value(),avail))return false;
+    }else{
+      cond_.wait(lock,avail);
+    }
+    ++nrunning_;
+    return true;
+  }
+  // release a slot
+  void release(){
+    {
+      lock_guard<mutex>lock(mtx_);
+      --nrunning_;
+    }
+    cond_.notify_one();
+  }
+  // set/get max #of slots
+  void setmax(size_t n){
+    {
+      lock_guard<mutex>lock(mtx_);
+      max_=n;
+    }
+    cond_.notify_all();
+  }
+  size_t max(){
+    lock_guard<mutex>lock(mtx_);
+    return max_;
+  }
+private:
+  mutex mtx_;
+  condition_variable cond_;
+  size_t max_=0;
+  size_t nrunning_=0;
+};
+ChildSlots childslots;
+}
+// spawn child process setting up stdout and stdin as a pipe
+optional<string>spawnpipchld(string const&file,vector<string>args,int&fdread,int&fdwrite,int&cpid,bool diewhenparentdies){
+  return spawnchld(file,args,nullptr,fdread,fdwrite,cpid,diewhenparentdies,false);
+}
+// spawn child process setting up stdout and stdin as a pipe, child gets environment 'env'
+optional<string>spawnpipchld(string const&file,vector<string>const&args,vector<string>const&env,int&fdread,int&fdwrite,int&cpid,bool diewhenparentdies,bool newpgrp){
+  return spawnchld(file,args,&env,fdread,fdwrite,cpid,diewhenparentdies,newpgrp);
+}
+// execute a program and capture output into a string
+// (of ret.first == true, output is in res->second, elase error is in ret->second)
+pair<bool,string>execprog(string file,vector<string>args){
+  int fdread;
+  int fdwrite;
+  int cpid;
+  auto res=spawnpipchld(file,args,fdread,fdwrite,cpid,true);
+  if(res)return pair(false,res.value());
+  bool timedout;
+  return collectchld(fdread,fdwrite,cpid,nullopt,timedout);
+}
+// execute a program with environment 'env' and capture output into a string
+// (if deadline passes before program terminates, the process group of the program is killed and 'timedout' is set)
+pair<bool,string>execprog(string const&file,vector<string>const&args,vector<string>const&env,
+                          optional<chrono::steady_clock::time_point>const&deadline,bool&timedout){
+  // wait for a free child slot
+  timedout=false;
+  if(!childslots.acquire(deadline)){
+    timedout=true;
+    return pair(false,"deadline passed while waiting for a free child process slot"s);
+  }
+  int fdread;
+  int fdwrite;
+  int cpid;
+  auto res=spawnpipchld(file,args,env,fdread,fdwrite,cpid,true,deadline.has_value());
+  if(res){
+    childslots.release();
+    return pair(false,res.value());
+  }
+  auto ret=collectchld(fdread,fdwrite,cpid,deadline,timedout);
+  childslots.release();
+  return ret;
+}
+// limit #of concurrently executing child processes
+void setmaxchildren(size_t n){
+  childslots.setmax(n);
+}
+size_t maxchildren(){
+  return childslots.max();
+}
+// acquire/release a child slot
+bool acquirechildslot(optional<chrono::steady_clock::time_point>const&deadline){
+  return childslots.acquire(deadline);
+}
+void releasechildslot(){
+  childslots.release();
+}
+// remaining time until a deadline in ms (-1 --> no deadline)
+// (rounded up so a poll timing out means the deadline has passed)
+int msleft(optional<chrono::steady_clock::time_point>const&deadline){
+  if(!deadline)return -1;
+  auto left=chrono::ceil<chrono::milliseconds>(deadline.value()-chrono::steady_clock::now()).count();
+  return left<0?0:static_cast<int>(min<decltype(left)>(left,numeric_limits<int>::max()));
 }
 }
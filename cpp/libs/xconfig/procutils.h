@@ -1,7 +1,9 @@
 // (C) Copyright Hans Ewetz 2018. All rights reserved.
 #pragma once
+#include <string>
 #include <vector>
 #include <optional>
+#include <chrono>
 namespace xconfig{
 
 // close an fd with error checking
@@ -12,9 +14,34 @@ int eclose(int fd);
 // (returns std::nullopt if no errors, else an error string)
 std::optional<std::string>parseexitstat(int stat);
 
+// convert exit status + output from child into a result
+// (a trailing newline is removed from output)
+std::pair<bool,std::string>exitstat2result(int stat,std::string&out);
+
 // spawn child process setting up stdout and stdin as a pipe
+// (child inherits the process environment, or gets 'env' - a list of 'NAME=VALUE' strings)
+// (if 'newpgrp' is true the child is made leader of a new process group)
 std::optional<std::string>spawnpipchld(std::string const&file,std::vector<std::string>args,int&fdread,int&fdwrite,int&cpid,bool diewhenparentdies);
+std::optional<std::string>spawnpipchld(std::string const&file,std::vector<std::string>const&args,std::vector<std::string>const&env,int&fdread,int&fdwrite,int&cpid,bool diewhenparentdies,bool newpgrp=false);
 
 // execute a program and get output into a string
 std::pair<bool,std::string>execprog(std::string file,std::vector<std::string>args);
+
+// execute a program with environment 'env' and get output into a string
+// (if 'deadline' passes before the program has terminated, the process group of the program is killed and 'timedout' is set)
+std::pair<bool,std::string>execprog(std::string const&file,std::vector<std::string>const&args,std::vector<std::string>const&env,
+                                    std::optional<std::chrono::steady_clock::time_point>const&deadline,bool&timedout);
+
+// limit #of child processes executing concurrently in the process (0 --> no limit)
+// (applies to programs executed with 'execprog(...)')
+void setmaxchildren(std::size_t n);
+std::size_t maxchildren();
+
+// acquire/release one of the slots limiting #of concurrently executing child processes
+// (acquirechildslot returns false if deadline passes before a slot becomes available)
+bool acquirechildslot(std::optional<std::chrono::steady_clock::time_point>const&deadline);
+void releasechildslot();
+
+// remaining time until a deadline in ms - suitable for 'poll(...)' (-1 --> no deadline)
+int msleft(std::optional<std::chrono::steady_clock::time_point>const&deadline);
 }
@@ -57,13 +57,19 @@ estring `(\\.|[^`\\])*\`
            }
 "="        return yy::comp_parser::make_ASSIGN(loc); 
 "+"        return yy::comp_parser::make_PLUS(loc); 
+"??"       return yy::comp_parser::make_FALLBACK(loc); 
 "`"        return yy::comp_parser::make_BS(loc); 
 "("        return yy::comp_parser::make_LP(loc); 
 ")"        return yy::comp_parser::make_RP(loc); 
 "{"        return yy::comp_parser::make_LB(loc); 
 "}"        return yy::comp_parser::make_RB(loc); 
+"["        return yy::comp_parser::make_LBRACKET(loc); 
+"]"        return yy::comp_parser::make_RBRACKET(loc); 
+","        return yy::comp_parser::make_COMMA(loc); 
+":"        return yy::comp_parser::make_COLON(loc); 
 "@"        return yy::comp_parser::make_AT(loc); 
 "namespace" return yy::comp_parser::make_NAMESPACE(loc);
+"cache"    return yy::comp_parser::make_CACHE(loc);
 
 {int}      {
              errno=0;
@@ -76,15 +82,15 @@ estring `(\\.|[^`\\])*\`
 
 {qstring}  { string tmp=yytext;
              tmp=tmp.substr(1,tmp.length()-2);
-             auto res=xconfig::deescape(tmp,{'\"'});
+             auto res=xconfig::deescape(std::move(tmp),{'\"'});
              if(!res.first)driver.error(loc,res.second);
-             return yy::comp_parser::make_QSTRING(res.second,loc);}
+             return yy::comp_parser::make_QSTRING(std::move(res.second),loc);}
 
 {estring}  { string tmp=yytext;
              tmp=tmp.substr(1,tmp.length()-2);
-             auto res=xconfig::deescape(tmp,{'`'});
+             auto res=xconfig::deescape(std::move(tmp),{'`'});
              if(!res.first)driver.error(loc,res.second);
-             return yy::comp_parser::make_ESTRING(res.second,loc);}
+             return yy::comp_parser::make_ESTRING(std::move(res.second),loc);}
 
 {id}      {
              char*pyytext=yytext;
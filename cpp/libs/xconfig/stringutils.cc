@@ -6,6 +6,8 @@
 #include <sstream>
 #include <iterator>
 #include <iostream>
+#include <cstring>
+#include <cstdint>
 using namespace std;
 namespace xconfig{
 
@@ -16,41 +18,69 @@ bool valididc(bool allowdot,char c){
   if(!allowdot)return (c>='a'&&c<'z')||(c>='A'&&c<='Z')||(c>='0'&&c<='9')||c=='_';
   return (c>='a'&&c<'z')||(c>='A'&&c<='Z')||(c>='0'&&c<='9')||c=='_'||c=='.';
 }
+// check if a character can be part of an environment variable name
+bool isenvc(char c){
+  return (c>='a'&&c<='z')||(c>='A'&&c<='Z')||(c>='0'&&c<='9')||c=='_';
+}
+// find index of first '$', '%', '`' or '\' in str[ind,n) - n if there is none
+// (tests 8 characters at a time: a byte of 'w^mask' is zero where a byte of 'w' equals the character in mask)
+size_t findspecial(char const*str,size_t n,size_t ind)noexcept{
+  constexpr uint64_t ones=0x0101010101010101ULL;
+  constexpr uint64_t highs=0x8080808080808080ULL;
+  auto haszero=[](uint64_t x){return (x-ones)&~x&highs;};
+  for(;ind+sizeof(uint64_t)<=n;ind+=sizeof(uint64_t)){
+    uint64_t w;
+    memcpy(&w,str+ind,sizeof(w));
+    if(haszero(w^(ones*'$'))|haszero(w^(ones*'%'))|haszero(w^(ones*'`'))|haszero(w^(ones*'\\')))break;
+  }
+  for(;ind<n;++ind){
+    char c=str[ind];
+    if(c=='$'||c=='%'||c=='`'||c=='\\')break;
+  }
+  return ind;
+}
 }
 // de-escape double quotations and escape-chars in a string
-pair<bool,string>deescape(string const&str,set<char>const&escchars){
-  set<char>echars=escchars;
-  echars.insert('\\');
-  stringstream ret;
-  int ind=0;
-  int n=str.size();
-  while(ind<n){
-    char c=str[ind++];
-    if(c=='\\'){
-      if(ind==n)return pair(false,"escape character '\\' found at end of string: ");
-      c=str[ind++];
-      if(!echars.count(c))ret<<'\\';   // we want to preserve other escaped characters since they can be stripped at runtime during interpolation
-      ret<<c;
-    }else{
-      ret<<c;
-    }
+pair<bool,string>deescape(string str,set<char>const&escchars){
+  char const*begin=str.data();
+  char const*end=begin+str.size();
+  char const*p=static_cast<char const*>(memchr(begin,'\\',str.size()));
+  if(!p)return pair(true,std::move(str));
+
+  // copy spans between escape characters in bulk
+  string ret;
+  ret.reserve(str.size());
+  char const*from=begin;
+  while(p){
+    ret.append(from,p);
+    if(p+1==end)return pair(false,"escape character '\\' found at end of string: ");
+    char c=p[1];
+    if(c!='\\'&&!escchars.count(c))ret.push_back('\\');   // we want to preserve other escaped characters since they can be stripped at runtime during interpolation
+    ret.push_back(c);
+    from=p+2;
+    p=static_cast<char const*>(memchr(from,'\\',end-from));
   }
-  return pair(true,ret.str());
+  ret.append(from,end);
+  return pair(true,std::move(ret));
 }
 // interpolate a string
 // (escape chars: ['"$%{}\])
 // (envvar - $xxx or ${xxx})
 // (memvar - %xxx or %{xxx})
 // (returns: (true,result) if no errors, (false,errstr) if error)
-pair<bool,string>interpolate(string const&str,
+pair<bool,string>interpolate(string str,
                              function<pair<bool,string>(string const&)>const&fenv,
                              function<pair<bool,string>(string const&)>const&fvar,
                              function<pair<bool,string>(string const&)>const&fcmd,
                              Symtab const&symtab){
-  static set<char>escchars={'$','%','`'};
-  stringstream ret;
-  int ind=0;
   int n=str.size();
+  int ind=findspecial(str.data(),n,0);
+  if(ind==n)return pair(true,std::move(str));
+
+  // copy spans between special characters in bulk
+  string ret;
+  ret.reserve(n);
+  ret.append(str,0,ind);
   while(ind<n){
     char c=str[ind++];
 
@@ -60,90 +90,107 @@ pair<bool,string>interpolate(string const&str,
     if(c=='\\'){
       if(ind==n)return pair(false,"escape character '\\' found at end of string: ");
       c=str[ind++];
-      if(!escchars.count(c))return pair(false,"invalid escape sequence '\\"s+c+"' - can only escape characters: [\\\"$%]");
-      ret<<c;
-      continue;
-    }
-    // check if we have a non-escaped character with no special meaning
-    if(escchars.count(c)==0){
-      ret<<c;
-      continue;
-    }
-    // check if we have an embedded command
-    if(c=='`'){
+      if(c!='$'&&c!='%'&&c!='`')return pair(false,"invalid escape sequence '\\"s+c+"' - can only escape characters: [\\\"$%]");
+      ret.push_back(c);
+    }else if(c=='`'){
+      // we have an embedded command
       if(ind==n)return pair(false,"found ` at end of string");
-      stringstream scmd;
-      c=str[ind++];
-      while(c!='`'){
-        scmd<<c;
-        if(ind==n)return pair(false,"no matching '`' for command");
-        c=str[ind++];
-      }
-      // check if we got a cmd and get it as a string
-      if(c!='`')return pair(false,"no matching '`' for command");
-      string cmd=scmd.str();
+      char const*cmdend=static_cast<char const*>(memchr(str.data()+ind,'`',n-ind));
+      if(!cmdend)return pair(false,"no matching '`' for command");
+      int cmdlen=cmdend-(str.data()+ind);
+      string cmd=str.substr(ind,cmdlen);
+      ind+=cmdlen+1;
 
       // execute cmd
       auto cmdres=fcmd(cmd);
       if(!cmdres.first)return pair(false,"failed executing cmd: "s+cmd);
-      ret<<cmdres.second;
-      continue;
-    }
-    // we either have an env variable or a normal program variable
-    // remember type of variable
-    bool isenv=c=='$'?true:false;
-
-    // we have an environment or memory variable (either $xxx, ${xxx}, %xxx or %xxx)
-    if(ind==n)return pair(false,"found '"s+c+"' at end of string");
-    stringstream sname;
-    c=str[ind++];
-    if(c=='{'){
-      // search for a matching '}' - we can only have chars in [a-zA-Z0-9_]
-      bool allowdot=false;
-      while(ind<n&&(c=str[ind++])!='}'){
-        if(!valididc(allowdot,c))return pair(false,"invalid character: "s+c+" inside interpolated variable name");
-        allowdot=!isenv;
-        sname<<c;
-      }
-      // check if we got a name
-      if(c!='}')return pair(false,"no matching '}' for '{'");
+      ret.append(cmdres.second);
     }else{
-      // search for a character that is not a valid ident char
-      bool allowdot=false;
-      for(valididc(allowdot,c);;){
-        allowdot=!isenv;
-        sname<<c;
-       if(ind==n)break;
-       c=str[ind];
-       if(!valididc(allowdot,c))break;
-       ++ind;
+      // we either have an env variable or a normal program variable
+      // remember type of variable
+      bool isenv=c=='$'?true:false;
+
+      // we have an environment or memory variable (either $xxx, ${xxx}, %xxx or %xxx)
+      if(ind==n)return pair(false,"found '"s+c+"' at end of string");
+      string name;
+      c=str[ind++];
+      if(c=='{'){
+        // search for a matching '}' - we can only have chars in [a-zA-Z0-9_]
+        bool allowdot=false;
+        while(ind<n&&(c=str[ind++])!='}'){
+          if(!valididc(allowdot,c))return pair(false,"invalid character: "s+c+" inside interpolated variable name");
+          allowdot=!isenv;
+          name.push_back(c);
+        }
+        // check if we got a name
+        if(c!='}')return pair(false,"no matching '}' for '{'");
+      }else{
+        // search for a character that is not a valid ident char
+        bool allowdot=false;
+        for(valididc(allowdot,c);;){
+          allowdot=!isenv;
+          name.push_back(c);
+         if(ind==n)break;
+         c=str[ind];
+         if(!valididc(allowdot,c))break;
+         ++ind;
+        }
       }
-    }
-    // we now have a name for variable (env or var)
-    string name=sname.str();
-    if(name.length()==0)return pair(false,"found empty name (environment or variable)");
+      // we now have a name for variable (env or var)
+      if(name.length()==0)return pair(false,"found empty name (environment or variable)");
 
-    // depending on if we have an env var or memory variable do something
-    if(isenv){
-      auto envres=fenv(name);
-      if(!envres.first)return pair(false,"failed getting environment variable for name: "s+name);
-      ret<<envres.second;
-    }else{
-      // lookup fully qualified name in symtab
-      auto fqname=symtab.lookupsym(name);
-      if(!fqname)return pair(false,"symbol: '"s+name+"' not found in current namespace: '"+symtab.currentns()+"' during interpolation");
+      // depending on if we have an env var or memory variable do something
+      if(isenv){
+        auto envres=fenv(name);
+        if(!envres.first)return pair(false,"failed getting environment variable for name: "s+name);
+        ret.append(envres.second);
+      }else{
+        // lookup fully qualified name in symtab
+        auto fqname=symtab.lookupsym(name);
+        if(!fqname)return pair(false,"symbol: '"s+name+"' not found in current namespace: '"+symtab.currentns()+"' during interpolation");
 
-      // get variable from memory
-      auto varres=fvar(fqname.value());
-      if(!varres.first)return pair(false,"failed getting variable for name: "s+name);
-      ret<<varres.second;
+        // get variable from memory
+        auto varres=fvar(fqname.value());
+        if(!varres.first)return pair(false,"failed getting variable for name: "s+name);
+        ret.append(varres.second);
+      }
     }
+    // copy characters up to next special character
+    int next=findspecial(str.data(),n,ind);
+    ret.append(str,ind,next-ind);
+    ind=next;
   }
-  return pair(true,ret.str());
+  return pair(true,std::move(ret));
+}
+// check if a string contains characters that are processed by 'interpolate(...)'
+bool needsinterpolation(string const&str)noexcept{
+  return findspecial(str.data(),str.size(),0)!=str.size();
 }
 // split string on blanks and return a vector
 vector<string>splitonblanks(string const&str){
   istringstream iss(str);
   return vector<string>(istream_iterator<string>(iss),istream_iterator<string>());
 }
+// get names of environment variables referenced in a shell command
+vector<string>envrefs(string const&cmd){
+  vector<string>ret;
+  for(size_t ind=0;ind<cmd.size();++ind){
+    if(cmd[ind]!='$')continue;
+    size_t start=ind+1;
+    if(start<cmd.size()&&cmd[start]=='{')++start;
+    size_t end=start;
+    while(end<cmd.size()&&isenvc(cmd[end]))++end;
+    if(end>start)ret.push_back(cmd.substr(start,end-start));
+  }
+  return ret;
+}
+// 64 bit FNV-1a hash
+uint64_t fnv1a(string const&str)noexcept{
+  uint64_t h=14695981039346656037ULL;
+  for(unsigned char c:str){
+    h^=c;
+    h*=1099511628211ULL;
+  }
+  return h;
+}
 }
@@ -4,20 +4,32 @@
 #include <set>
 #include <vector>
 #include <functional>
+#include <cstdint>
 namespace xconfig{
 
 // forward decl
 class Symtab;
 
 // de-escape double quotatinos in a string
-std::pair<bool,std::string>deescape(std::string const&str,std::set<char>const&escchars);
+// (a string without escape characters is returned as is - pass an rvalue to avoid copying it)
+std::pair<bool,std::string>deescape(std::string str,std::set<char>const&escchars);
 
 // interpolate a string
-std::pair<bool,std::string>interpolate(std::string const&str,
+// (a string without '$', '%', '`' or '\\' is returned as is - pass an rvalue to avoid copying it)
+std::pair<bool,std::string>interpolate(std::string str,
                                        std::function<std::pair<bool,std::string>(std::string const&)>const&fenv,
                                        std::function<std::pair<bool,std::string>(std::string const&)>const&fvar,
                                        std::function<std::pair<bool,std::string>(std::string const&)>const&fcmd,
                                        Symtab const&symtab);
+// check if a string contains characters that are processed by 'interpolate(...)'
+bool needsinterpolation(std::string const&str)noexcept;
+
 // split string on blanks and return a vector
 std::vector<std::string>splitonblanks(std::string const&str);
+
+// get names of environment variables referenced in a shell command ($xxx or ${xxx})
+std::vector<std::string>envrefs(std::string const&cmd);
+
+// 64 bit FNV-1a hash (stable between runs - std::hash is not required to be)
+std::uint64_t fnv1a(std::string const&str)noexcept;
 }